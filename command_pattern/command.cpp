@@ -2,18 +2,52 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+#include "command_executor.h"
+#include "command_journal.h"
+#include <chrono>
 #include <functional>
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 namespace {
 
-void log(std::string message) { std::cout << "Logging: " + message << "\n"; }
+/**
+ * Write one line with a single call, so that lines of commands running on
+ * different threads do not interleave.
+ */
+void write_line(std::string_view prefix, std::string_view message) {
+  thread_local std::string line;
+  line.assign(prefix);
+  line.append(message);
+  line.push_back('\n');
+  std::cout.write(line.data(), line.size());
+}
+
+void log(std::string_view message) { write_line("Logging: ", message); }
 
-void save(std::string message) { std::cout << "Saving: " + message << "\n"; }
+void save(std::string_view message) { write_line("Saving: ", message); }
 
-void send(std::string message) { std::cout << "Sending: " + message << "\n"; }
+void send(std::string_view message) { write_line("Sending: ", message); }
+
+/**
+ * Handle a whole batch with a single write, reusing one buffer per thread.
+ */
+batch_handler batched(std::string_view prefix) {
+  return [prefix](const command_batch &batch) {
+    thread_local std::string out;
+    out.clear();
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+      out.append(prefix);
+      out.append(batch[i]);
+      out.push_back('\n');
+    }
+    std::cout.write(out.data(), out.size());
+    std::cout.flush();
+  };
+}
 
 } // namespace
 
@@ -31,7 +65,88 @@ void CommandTest() {
   }
 }
 
+/**
+ * ! The same tasks on a concurrent executor: a slow send no longer holds back
+ * ! the logs, but still only runs after its save.
+ */
+void ExecutorTest() {
+  command_executor executor;
+  const command_kind LOG = executor.kind("log");
+  const command_kind SAVE = executor.kind("save");
+  const command_kind SEND = executor.kind("send");
+  for (int i = 0; i < 3; ++i) {
+    auto saved = executor.submit(SAVE, [] { save("Cheers"); });
+    executor.submit(
+        SEND,
+        [] {
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+          send("Bye");
+        },
+        command_priority::low, {saved});
+    executor.submit(LOG, [] { log("Hi"); }, command_priority::high);
+  }
+  executor.wait();
+  executor.report(std::cout);
+}
+
+/**
+ * ! Thousands of small commands of one kind are coalesced: every batch of logs
+ * ! is one write, and every send waits for the batch holding its save.
+ */
+void BatchTest() {
+  command_executor executor;
+  const command_kind LOG = executor.make_batchable("log", batched("Logging: "));
+  const command_kind SAVE =
+      executor.make_batchable("save", batched("Saving: "));
+  const command_kind SEND = executor.kind("send");
+  for (int i = 0; i < 1000; ++i) {
+    executor.submit_batched(LOG, "Hi");
+    auto saved = executor.submit_batched(SAVE, "Cheers");
+    if (i % 250 == 0)
+      executor.submit(SEND, [] { send("Bye"); }, command_priority::low,
+                      {saved});
+  }
+  executor.wait();
+  executor.report(std::cout);
+}
+
+/**
+ * ! Journaled commands have an identity, so they survive a crash and can be
+ * ! undone.
+ */
+void JournalTest() {
+  enum : command_journal::command_type { LOG, SAVE, SEND };
+  const std::string path = "command_test.journal";
+  auto register_types = [](command_journal &journal) {
+    journal.register_type(LOG, [](std::string_view m) { log(m); });
+    journal.register_type(
+        SAVE, [](std::string_view m) { save(m); },
+        [](std::string_view m) { write_line("Unsaving: ", m); });
+    journal.register_type(SEND, [](std::string_view m) { send(m); });
+  };
+
+  {
+    command_journal journal(path);
+    register_types(journal);
+    journal.execute(LOG, "Hi");
+    journal.execute(SAVE, "Cheers");
+    journal.undo_last();
+    // Recorded but never run, as if the process died right here.
+    journal.record(SEND, "Bye");
+    journal.commit();
+  }
+
+  command_journal journal(path);
+  register_types(journal);
+  const std::size_t replayed = journal.replay();
+  std::cout << "Replayed " << replayed << " command(s)\n";
+  ::unlink(path.c_str());
+}
+
 int main() {
   CommandTest();
+  ExecutorTest();
+  BatchTest();
+  JournalTest();
   return 0;
 }
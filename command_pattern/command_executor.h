@@ -0,0 +1,621 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef COMMAND_EXECUTOR_H
+#define COMMAND_EXECUTOR_H
+
+#include "../common/inplace_function.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+ * A command stored in place. Captures of up to 64 bytes never touch the heap.
+ */
+using command = stdext::inplace_function<void(), 64>;
+
+enum class command_priority { low, normal, high };
+
+/**
+ * Identifies a submitted command, e.g. to let another command wait for it.
+ */
+struct command_id {
+  std::uint32_t slot;
+  std::uint32_t generation;
+};
+
+/**
+ * The messages of all commands of one kind that were coalesced into a single
+ * batched invocation, stored back to back in one buffer.
+ */
+class command_batch {
+public:
+  std::size_t size() const { return ends_.size(); }
+
+  std::string_view operator[](std::size_t i) const {
+    const std::size_t begin = i ? ends_[i - 1] : 0;
+    return std::string_view(bytes_).substr(begin, ends_[i] - begin);
+  }
+
+  void add(std::string_view message) {
+    bytes_.append(message);
+    ends_.push_back(bytes_.size());
+  }
+
+  // Keeps the capacity, so a reused batch stops allocating.
+  void clear() {
+    bytes_.clear();
+    ends_.clear();
+  }
+
+private:
+  std::string bytes_;
+  std::vector<std::size_t> ends_;
+};
+
+using batch_handler = std::function<void(const command_batch &)>;
+
+/**
+ * Histogram of latencies in power of two buckets of nanoseconds.
+ */
+class latency_histogram {
+public:
+  static constexpr std::size_t buckets = 40;
+
+  void add(std::chrono::nanoseconds latency) {
+    const auto ns =
+        static_cast<std::uint64_t>(std::max<std::int64_t>(latency.count(), 1));
+    const std::size_t bucket = 63 - __builtin_clzll(ns);
+    counts_[std::min(bucket, buckets - 1)].fetch_add(1,
+                                                     std::memory_order_relaxed);
+  }
+
+  /**
+   * Add the counts of another histogram, e.g. of another thread.
+   */
+  void merge(const latency_histogram &other) {
+    for (std::size_t b = 0; b < buckets; ++b)
+      counts_[b].fetch_add(other.counts_[b].load(std::memory_order_relaxed),
+                           std::memory_order_relaxed);
+  }
+
+  std::uint64_t count() const {
+    std::uint64_t n = 0;
+    for (const auto &c : counts_)
+      n += c.load(std::memory_order_relaxed);
+    return n;
+  }
+
+  /**
+   * Upper bound of the bucket holding the given percentile (0-100).
+   */
+  std::chrono::nanoseconds percentile(double p) const {
+    const std::uint64_t n = count();
+    std::uint64_t seen = 0;
+    for (std::size_t b = 0; b < buckets; ++b) {
+      seen += counts_[b].load(std::memory_order_relaxed);
+      if (n && seen * 100.0 >= p * n)
+        return std::chrono::nanoseconds(std::uint64_t(2) << b);
+    }
+    return std::chrono::nanoseconds(0);
+  }
+
+private:
+  std::array<std::atomic<std::uint64_t>, buckets> counts_{};
+};
+
+/**
+ * Kinds of commands, e.g. log, interned once by command_executor::kind.
+ */
+struct command_kind {
+  std::uint32_t index;
+};
+
+/**
+ * A queue of slots after the Chase-Lev work-stealing deque: the owning thread
+ * pushes at the bottom, and every thread, the owner too, takes from the top,
+ * so slots are taken in the order they were pushed. Taking from the top
+ * keeps chains of dependent commands interleaved, as they were queued,
+ * instead of following one chain through memory. Grows by doubling and keeps
+ * retired rings until destruction, since a thief may still read them.
+ */
+class work_stealing_queue {
+public:
+  work_stealing_queue() : ring_(new ring(1024)) { rings_.emplace_back(ring_); }
+
+  work_stealing_queue(const work_stealing_queue &) = delete;
+  work_stealing_queue &operator=(const work_stealing_queue &) = delete;
+
+  /**
+   * Owner only.
+   */
+  void push(std::uint32_t slot) {
+    const std::int64_t b = bottom_.load(std::memory_order_relaxed);
+    const std::int64_t t = top_.load(std::memory_order_acquire);
+    ring *r = ring_.load(std::memory_order_relaxed);
+    if (b - t > r->mask)
+      r = grow(r, t, b);
+    r->at(b).store(slot, std::memory_order_relaxed);
+    // Sequentially consistent, so sleeping workers see it; see notify().
+    bottom_.store(b + 1, std::memory_order_seq_cst);
+  }
+
+  /**
+   * Any thread: the slot pushed first.
+   */
+  bool take(std::uint32_t &slot) {
+    std::int64_t t = top_.load(std::memory_order_seq_cst);
+    const std::int64_t b = bottom_.load(std::memory_order_seq_cst);
+    if (t >= b)
+      return false;
+    ring *r = ring_.load(std::memory_order_acquire);
+    slot = r->at(t).load(std::memory_order_relaxed);
+    return top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                        std::memory_order_relaxed);
+  }
+
+private:
+  struct ring {
+    explicit ring(std::int64_t size)
+        : mask(size - 1), slots(new std::atomic<std::uint32_t>[size]) {}
+
+    std::atomic<std::uint32_t> &at(std::int64_t i) { return slots[i & mask]; }
+
+    const std::int64_t mask;
+    std::unique_ptr<std::atomic<std::uint32_t>[]> slots;
+  };
+
+  ring *grow(ring *r, std::int64_t t, std::int64_t b) {
+    ring *bigger = new ring(2 * (r->mask + 1));
+    rings_.emplace_back(bigger);
+    for (std::int64_t i = t; i < b; ++i)
+      bigger->at(i).store(r->at(i).load(std::memory_order_relaxed),
+                          std::memory_order_relaxed);
+    ring_.store(bigger, std::memory_order_release);
+    return bigger;
+  }
+
+  alignas(64) std::atomic<std::int64_t> top_{0};
+  alignas(64) std::atomic<std::int64_t> bottom_{0};
+  std::atomic<ring *> ring_;
+  std::vector<std::unique_ptr<ring>> rings_; // owner only
+};
+
+/**
+ * Runs commands concurrently on a work-stealing thread pool.
+ *
+ * Every worker owns one work-stealing queue per priority, for commands
+ * submitted on it, and one inbox per priority for commands submitted from
+ * other threads, which are spread round robin. A worker takes from its own
+ * inbox and queue first and then steals from the others'--always trying
+ * higher priorities first. Idle workers sleep until a command is queued.
+ *
+ * A command may name commands it has to wait for; it is only queued once all
+ * of them have finished. Dependencies are tracked per command, with no lock
+ * shared by all commands. Latency from submission to completion is recorded
+ * per worker and kind of command, and merged by report(). Commands must not
+ * throw.
+ *
+ * Kinds of commands that only carry a message, like log, may be declared
+ * batchable. Their commands are coalesced: messages submitted while a batch
+ * of their kind is still queued join that batch, and one call of the batch
+ * handler processes all of them.
+ */
+class command_executor {
+public:
+  static constexpr std::size_t max_kinds = 64;
+
+  explicit command_executor(
+      unsigned threads = std::max(1u, std::thread::hardware_concurrency()))
+      : workers_(threads), batches_(max_kinds) {
+    for (auto &w : workers_)
+      w = std::make_unique<worker>();
+    for (unsigned i = 0; i < threads; ++i)
+      threads_.emplace_back([this, i] { work(i); });
+  }
+
+  command_executor(const command_executor &) = delete;
+  command_executor &operator=(const command_executor &) = delete;
+
+  ~command_executor() {
+    wait();
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto &t : threads_)
+      t.join();
+    for (auto &block : blocks_)
+      delete[] block.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * The kind of command of the given name, e.g. "log". Look kinds up once,
+   * not per command.
+   */
+  command_kind kind(const std::string &name) {
+    std::lock_guard<std::mutex> lock(kinds_mutex_);
+    const std::size_t n = kind_count_.load(std::memory_order_relaxed);
+    for (std::size_t k = 0; k < n; ++k)
+      if (kind_names_[k] == name)
+        return command_kind{std::uint32_t(k)};
+    if (n == max_kinds)
+      throw std::length_error("command_executor: too many kinds of commands");
+    kind_names_[n] = name;
+    kind_count_.store(n + 1, std::memory_order_release);
+    return command_kind{std::uint32_t(n)};
+  }
+
+  /**
+   * Submit a command of the given kind. The command runs once every command
+   * in after has finished.
+   */
+  command_id submit(command_kind kind, command cmd,
+                    command_priority priority = command_priority::normal,
+                    std::initializer_list<command_id> after = {}) {
+    // Counted only once the slot is taken: allocate_slot may throw.
+    const std::uint32_t slot = allocate_slot();
+    in_flight_.fetch_add(1, std::memory_order_relaxed);
+    node &n = at(slot);
+    n.cmd = std::move(cmd);
+    n.priority = priority;
+    n.kind = kind.index;
+    n.submitted = clock::now();
+    std::uint32_t generation;
+    {
+      std::lock_guard<std::mutex> lock(n.mutex);
+      n.pending = true;
+      generation = n.generation;
+    }
+    // One extra, so the command cannot start before all edges are added.
+    n.waiting_for.store(1, std::memory_order_relaxed);
+    for (const command_id &id : after) {
+      node *d = find(id.slot);
+      if (!d)
+        continue;
+      std::lock_guard<std::mutex> lock(d->mutex);
+      if (d->generation == id.generation && d->pending) {
+        d->dependents.push_back(slot);
+        n.waiting_for.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    if (n.waiting_for.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      schedule(slot);
+    return command_id{slot, generation};
+  }
+
+  /**
+   * Declare a kind of command as batchable. Declare every batchable kind
+   * before submitting commands of it.
+   */
+  command_kind make_batchable(const std::string &name, batch_handler handler) {
+    const command_kind k = kind(name);
+    batches_[k.index] = std::make_unique<batch_kind>();
+    batches_[k.index]->kind = k;
+    batches_[k.index]->handler = std::move(handler);
+    return k;
+  }
+
+  /**
+   * Submit a command of a batchable kind. The message is copied into the
+   * pending batch of its kind. The returned id stands for the whole batch,
+   * so commands waiting for it wait for all messages of the batch.
+   */
+  command_id submit_batched(command_kind kind, std::string_view message,
+                            command_priority priority =
+                                command_priority::normal) {
+    if (kind.index >= max_kinds || !batches_[kind.index])
+      throw std::invalid_argument("command_executor: not batchable: " +
+                                  kind_names_[kind.index % max_kinds]);
+    batch_kind &b = *batches_[kind.index];
+    std::lock_guard<std::mutex> lock(b.mutex);
+    b.pending.add(message);
+    if (!b.scheduled) {
+      b.scheduled = true;
+      b.flush = submit(kind, [this, &b] { flush(b); }, priority);
+    }
+    return b.flush;
+  }
+
+  /**
+   * Block until every submitted command has finished.
+   */
+  void wait() {
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    idle_.wait(lock, [this] {
+      return in_flight_.load(std::memory_order_acquire) == 0;
+    });
+  }
+
+  /**
+   * Print count and latency percentiles for every kind of command.
+   */
+  void report(std::ostream &os) const {
+    const std::size_t kinds = kind_count_.load(std::memory_order_acquire);
+    for (std::size_t k = 0; k < kinds; ++k) {
+      latency_histogram h;
+      for (const auto &w : workers_)
+        h.merge(w->latencies[k]);
+      os << kind_names_[k] << ": " << h.count() << " commands, p50 <= "
+         << h.percentile(50).count() << " ns, p99 <= "
+         << h.percentile(99).count() << " ns, max <= "
+         << h.percentile(100).count() << " ns\n";
+    }
+  }
+
+private:
+  using clock = std::chrono::steady_clock;
+
+  static constexpr std::uint32_t block_bits = 10;
+  static constexpr std::uint32_t block_size = 1u << block_bits;
+  static constexpr std::size_t max_blocks = 4096;
+  static constexpr std::size_t priorities = 3;
+
+  struct node {
+    command cmd;
+    command_priority priority = command_priority::normal;
+    std::uint32_t kind = 0;
+    clock::time_point submitted;
+    std::atomic<std::uint32_t> waiting_for{0};
+    std::atomic<std::uint32_t> next_free{0}; // slot + 1, 0 ends the list
+
+    std::mutex mutex; // guards generation, pending and dependents
+    std::uint32_t generation = 0;
+    bool pending = false;
+    std::vector<std::uint32_t> dependents;
+  };
+
+  struct inbox {
+    std::mutex mutex;
+    std::deque<std::uint32_t> slots;
+    std::atomic<std::size_t> size{0}; // read without the lock
+  };
+
+  struct alignas(64) worker {
+    std::array<work_stealing_queue, priorities> queues;
+    std::array<inbox, priorities> inboxes;
+    std::array<latency_histogram, max_kinds> latencies; // written by it only
+  };
+
+  struct batch_kind {
+    command_kind kind;
+    batch_handler handler;
+    std::mutex mutex; // guards pending, scheduled and flush
+    command_batch pending;
+    bool scheduled = false;
+    command_id flush{0, 0};
+    std::mutex flushing; // keeps batches of one kind in order
+    command_batch running;
+  };
+
+  node &at(std::uint32_t slot) {
+    return blocks_[slot >> block_bits].load(std::memory_order_acquire)
+        [slot & (block_size - 1)];
+  }
+
+  node *find(std::uint32_t slot) {
+    if (slot >= allocated_.load(std::memory_order_acquire))
+      return nullptr;
+    node *block = blocks_[slot >> block_bits].load(std::memory_order_acquire);
+    return block ? &block[slot & (block_size - 1)] : nullptr;
+  }
+
+  /**
+   * Pop a slot off the free list, a Treiber stack whose head carries a tag
+   * against ABA, or take a new one.
+   */
+  std::uint32_t allocate_slot() {
+    std::uint64_t head = free_.load(std::memory_order_acquire);
+    while (std::uint32_t top = std::uint32_t(head)) {
+      const std::uint32_t next =
+          at(top - 1).next_free.load(std::memory_order_relaxed);
+      const std::uint64_t tagged = ((head >> 32) + 1) << 32 | next;
+      if (free_.compare_exchange_weak(head, tagged, std::memory_order_acquire,
+                                      std::memory_order_acquire))
+        return top - 1;
+    }
+    // Take a new slot only while there is room, so a full executor stays
+    // as it is.
+    std::uint32_t slot = allocated_.load(std::memory_order_acquire);
+    do {
+      if (slot >= max_blocks * block_size)
+        throw std::length_error("command_executor: too many pending commands");
+    } while (!allocated_.compare_exchange_weak(slot, slot + 1,
+                                               std::memory_order_acq_rel,
+                                               std::memory_order_acquire));
+    const std::size_t b = slot >> block_bits;
+    if (!blocks_[b].load(std::memory_order_acquire)) {
+      node *block = new node[block_size];
+      node *expected = nullptr;
+      if (!blocks_[b].compare_exchange_strong(expected, block,
+                                              std::memory_order_acq_rel))
+        delete[] block;
+    }
+    return slot;
+  }
+
+  void free_slot(std::uint32_t slot) {
+    node &n = at(slot);
+    std::uint64_t head = free_.load(std::memory_order_relaxed);
+    std::uint64_t tagged;
+    do {
+      n.next_free.store(std::uint32_t(head), std::memory_order_relaxed);
+      tagged = ((head >> 32) + 1) << 32 | (slot + 1);
+    } while (!free_.compare_exchange_weak(head, tagged,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed));
+  }
+
+  void schedule(std::uint32_t slot) {
+    const std::size_t p = static_cast<std::size_t>(at(slot).priority);
+    if (this_executor_ == this) {
+      workers_[this_worker_]->queues[p].push(slot);
+    } else {
+      inbox &in = workers_[next_queue_.fetch_add(1, std::memory_order_relaxed) %
+                           workers_.size()]
+                      ->inboxes[p];
+      std::lock_guard<std::mutex> lock(in.mutex);
+      in.slots.push_back(slot);
+      in.size.store(in.slots.size(), std::memory_order_seq_cst);
+    }
+    notify();
+  }
+
+  /**
+   * Wake a sleeping worker, if any. A worker counts itself in sleepers_
+   * before it looks at the queues a last time, and queuing is sequentially
+   * consistent, so either it finds the command or it is woken here.
+   */
+  void notify() {
+    if (sleepers_.load(std::memory_order_seq_cst) == 0)
+      return;
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      ++epoch_;
+    }
+    wake_.notify_one();
+  }
+
+  static bool take_inbox(inbox &in, std::uint32_t &slot) {
+    if (in.size.load(std::memory_order_seq_cst) == 0)
+      return false;
+    std::lock_guard<std::mutex> lock(in.mutex);
+    if (in.slots.empty())
+      return false;
+    slot = in.slots.front();
+    in.slots.pop_front();
+    in.size.store(in.slots.size(), std::memory_order_seq_cst);
+    return true;
+  }
+
+  bool take(std::size_t self, std::uint32_t &slot) {
+    for (std::size_t p = priorities; p-- > 0;) {
+      worker &own = *workers_[self];
+      if (take_inbox(own.inboxes[p], slot) || own.queues[p].take(slot))
+        return true;
+      for (std::size_t i = 1; i < workers_.size(); ++i) {
+        worker &victim = *workers_[(self + i) % workers_.size()];
+        if (take_inbox(victim.inboxes[p], slot) ||
+            victim.queues[p].take(slot))
+          return true;
+      }
+    }
+    return false;
+  }
+
+  void work(std::size_t self) {
+    this_executor_ = this;
+    this_worker_ = self;
+    for (;;) {
+      std::uint32_t slot;
+      if (!take(self, slot)) {
+        sleepers_.fetch_add(1, std::memory_order_seq_cst);
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        const std::uint64_t epoch = epoch_;
+        lock.unlock();
+        const bool found = take(self, slot);
+        if (!found) {
+          lock.lock();
+          wake_.wait(lock, [&] { return stop_ || epoch_ != epoch; });
+          lock.unlock();
+        }
+        sleepers_.fetch_sub(1, std::memory_order_seq_cst);
+        if (!found) {
+          if (stop_now())
+            return;
+          continue;
+        }
+      }
+      node &n = at(slot);
+      n.cmd();
+      n.cmd = nullptr;
+      finish(self, slot);
+    }
+  }
+
+  bool stop_now() {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    return stop_;
+  }
+
+  void flush(batch_kind &b) {
+    std::lock_guard<std::mutex> in_order(b.flushing);
+    {
+      std::lock_guard<std::mutex> lock(b.mutex);
+      std::swap(b.pending, b.running);
+      b.scheduled = false;
+    }
+    b.handler(b.running);
+    b.running.clear();
+  }
+
+  void finish(std::size_t self, std::uint32_t slot) {
+    node &n = at(slot);
+    workers_[self]->latencies[n.kind].add(clock::now() - n.submitted);
+    {
+      std::lock_guard<std::mutex> lock(n.mutex);
+      for (std::uint32_t d : n.dependents)
+        if (at(d).waiting_for.fetch_sub(1, std::memory_order_acq_rel) == 1)
+          schedule(d);
+      n.dependents.clear();
+      n.pending = false;
+      ++n.generation;
+    }
+    free_slot(slot);
+    if (in_flight_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      std::lock_guard<std::mutex> lock(idle_mutex_);
+      idle_.notify_all();
+    }
+  }
+
+  // Set on worker threads only.
+  static thread_local const command_executor *this_executor_;
+  static thread_local std::size_t this_worker_;
+
+  std::vector<std::unique_ptr<worker>> workers_;
+  std::vector<std::thread> threads_;
+  std::atomic<std::size_t> next_queue_{0};
+
+  std::atomic<unsigned> sleepers_{0};
+  std::mutex sleep_mutex_; // guards epoch_ and stop_
+  std::condition_variable wake_;
+  std::uint64_t epoch_ = 0;
+  bool stop_ = false;
+
+  std::atomic<std::size_t> in_flight_{0};
+  std::mutex idle_mutex_;
+  std::condition_variable idle_;
+
+  // Nodes live in blocks that are never moved or freed before destruction.
+  std::array<std::atomic<node *>, max_blocks> blocks_{};
+  std::atomic<std::uint32_t> allocated_{0};
+  std::atomic<std::uint64_t> free_{0}; // tag << 32 | (slot + 1)
+
+  std::mutex kinds_mutex_; // serializes kind()
+  std::array<std::string, max_kinds> kind_names_;
+  std::atomic<std::size_t> kind_count_{0};
+
+  std::vector<std::unique_ptr<batch_kind>> batches_; // by kind
+};
+
+inline thread_local const command_executor *command_executor::this_executor_ =
+    nullptr;
+inline thread_local std::size_t command_executor::this_worker_ = 0;
+
+#endif /* end of include guard: COMMAND_EXECUTOR_H */
@@ -0,0 +1,371 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef COMMAND_JOURNAL_H
+#define COMMAND_JOURNAL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * An append-only, memory-mapped log of commands.
+ *
+ * Commands get an identity: a registered type and a serialized payload.
+ * Every command is recorded before it runs and marked as completed after,
+ * so commands that were recorded but never completed--because the process
+ * died--are run again by replay() on the next start. Commands whose type
+ * provides an inverse can be undone.
+ *
+ * Appending is a memcpy into the mapping. Durability is a separate step:
+ * commit() makes everything appended so far durable with a single
+ * fdatasync, and concurrent committers share that one sync (group commit).
+ *
+ * On disk, the journal is a magic number followed by records:
+ *      | payload size | checksum | sequence number | type | kind | payload |
+ * padded to 8 bytes. Reading stops at the first record whose checksum does
+ * not match, so a torn write at the tail is ignored.
+ */
+class command_journal {
+public:
+  using sequence = std::uint64_t;
+  using command_type = std::uint16_t;
+  using handler = std::function<void(std::string_view payload)>;
+
+  explicit command_journal(const std::string &path,
+                           std::size_t initial_capacity = 1 << 20) {
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0)
+      throw std::runtime_error("command_journal: cannot open " + path);
+    try {
+      struct stat st;
+      if (::fstat(fd_, &st) != 0)
+        throw std::runtime_error("command_journal: cannot stat " + path);
+      // Checked before mapping, which would grow the file.
+      char header[sizeof(magic)];
+      if (st.st_size != 0 &&
+          (::pread(fd_, header, sizeof(header), 0) != sizeof(header) ||
+           std::memcmp(header, magic, sizeof(magic)) != 0))
+        throw std::runtime_error("command_journal: not a journal: " + path);
+      map(std::max<std::size_t>(st.st_size, initial_capacity));
+      if (st.st_size == 0)
+        std::memcpy(data_, magic, sizeof(magic));
+      end_ = sizeof(magic);
+      scan();
+    } catch (...) {
+      if (data_)
+        ::munmap(data_, capacity_);
+      ::close(fd_);
+      throw;
+    }
+    durable_end_ = end_;
+  }
+
+  command_journal(const command_journal &) = delete;
+  command_journal &operator=(const command_journal &) = delete;
+
+  ~command_journal() {
+    commit();
+    ::munmap(data_, capacity_);
+    if (::ftruncate(fd_, end_) != 0) {
+      // The zeroed tail fails its checksum and is ignored on the next open.
+    }
+    ::close(fd_);
+  }
+
+  /**
+   * Register how to run (and optionally undo) commands of a type. Register
+   * every type before replay().
+   */
+  void register_type(command_type type, handler apply,
+                     handler undo = nullptr) {
+    types_[type] = {std::move(apply), std::move(undo)};
+  }
+
+  /**
+   * Record a command without running it.
+   */
+  sequence record(command_type type, std::string_view payload) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const sequence seq = entries_.size();
+    entries_.push_back({append(seq, type, kind::recorded, payload),
+                        state::pending});
+    return seq;
+  }
+
+  /**
+   * Run a recorded command and mark it completed.
+   */
+  void run(sequence seq) {
+    command_type type;
+    const std::string payload = read(seq, type);
+    types_.at(type).apply(payload);
+    mark(seq, kind::completed, state::completed);
+  }
+
+  /**
+   * Record and run a command.
+   */
+  sequence execute(command_type type, std::string_view payload) {
+    const sequence seq = record(type, payload);
+    run(seq);
+    return seq;
+  }
+
+  /**
+   * Undo a completed command. Returns false if its type has no inverse or it
+   * is not completed, e.g. because another thread is undoing it.
+   */
+  bool undo(sequence seq) {
+    command_type type;
+    std::string payload;
+    const handler *inverse;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (seq >= entries_.size() || entries_[seq].st != state::completed)
+        return false;
+      payload = read_locked(seq, type);
+      inverse = &types_.at(type).undo;
+      if (!*inverse)
+        return false;
+      // Claimed, so no concurrent undo applies the inverse a second time.
+      entries_[seq].st = state::undoing;
+    }
+    try {
+      (*inverse)(payload);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      entries_[seq].st = state::completed;
+      throw;
+    }
+    mark(seq, kind::undone, state::undone);
+    return true;
+  }
+
+  /**
+   * Undo the most recent completed command that has an inverse.
+   */
+  bool undo_last() {
+    sequence seq;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      seq = entries_.size();
+    }
+    while (seq-- > 0) {
+      if (undo(seq))
+        return true;
+    }
+    return false;
+  }
+
+  /**
+   * Commands recorded but never completed, in order.
+   */
+  std::vector<sequence> pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<sequence> r;
+    for (sequence seq = 0; seq < entries_.size(); ++seq)
+      if (entries_[seq].st == state::pending)
+        r.push_back(seq);
+    return r;
+  }
+
+  /**
+   * Run every pending command. Returns how many ran.
+   */
+  std::size_t replay() {
+    const std::vector<sequence> todo = pending();
+    for (sequence seq : todo)
+      run(seq);
+    return todo.size();
+  }
+
+  /**
+   * Make everything appended so far durable. A commit already in progress
+   * that covers this caller's appends is waited for instead of repeated.
+   */
+  void commit() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const std::size_t target = end_;
+    while (durable_end_ < target) {
+      if (syncing_) {
+        synced_.wait(lock);
+        continue;
+      }
+      syncing_ = true;
+      const std::size_t covered = end_;
+      lock.unlock();
+      ::fdatasync(fd_);
+      lock.lock();
+      syncing_ = false;
+      durable_end_ = std::max(durable_end_, covered);
+      synced_.notify_all();
+    }
+  }
+
+  std::size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+  }
+
+private:
+  enum class kind : std::uint8_t { recorded = 1, completed = 2, undone = 3 };
+  enum class state : std::uint8_t { pending, completed, undoing, undone };
+
+  struct entry {
+    std::size_t offset; // of the recorded command
+    state st;
+  };
+
+  struct record_header {
+    std::uint32_t size;
+    std::uint32_t checksum;
+    sequence seq;
+    command_type type;
+    kind k;
+    std::uint8_t padding[5];
+  };
+
+  struct type_handlers {
+    handler apply;
+    handler undo;
+  };
+
+  static constexpr char magic[8] = {'C', 'M', 'D', 'J', 'R', 'N', 'L', '1'};
+
+  static std::size_t padded(std::size_t n) { return (n + 7) & ~std::size_t(7); }
+
+  static std::uint32_t checksum(const record_header &h, const char *payload) {
+    // FNV-1a over the header (without the checksum) and the payload.
+    std::uint32_t hash = 2166136261u;
+    auto mix = [&](const void *p, std::size_t n) {
+      const unsigned char *b = static_cast<const unsigned char *>(p);
+      for (std::size_t i = 0; i < n; ++i)
+        hash = (hash ^ b[i]) * 16777619u;
+    };
+    mix(&h.size, sizeof(h.size));
+    mix(&h.seq, sizeof(h.seq));
+    mix(&h.type, sizeof(h.type));
+    mix(&h.k, sizeof(h.k));
+    mix(payload, h.size);
+    return hash;
+  }
+
+  /**
+   * Map the journal at the given capacity. The old mapping, if any, stays in
+   * place until the new one succeeded.
+   */
+  void map(std::size_t capacity) {
+    if (::ftruncate(fd_, capacity) != 0)
+      throw std::runtime_error("command_journal: cannot grow journal");
+    void *p =
+        ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (p == MAP_FAILED)
+      throw std::runtime_error("command_journal: cannot map journal");
+    if (data_)
+      ::munmap(data_, capacity_);
+    data_ = static_cast<char *>(p);
+    capacity_ = capacity;
+  }
+
+  // Requires mutex_. Returns the offset of the new record.
+  std::size_t append(sequence seq, command_type type, kind k,
+                     std::string_view payload) {
+    const std::size_t bytes = padded(sizeof(record_header) + payload.size());
+    if (end_ + bytes > capacity_) {
+      std::size_t capacity = capacity_;
+      while (end_ + bytes > capacity)
+        capacity *= 2;
+      map(capacity);
+    }
+    record_header h{};
+    h.size = static_cast<std::uint32_t>(payload.size());
+    h.seq = seq;
+    h.type = type;
+    h.k = k;
+    h.checksum = checksum(h, payload.data());
+    const std::size_t offset = end_;
+    if (!payload.empty()) // marks have none, and maybe no data() either
+      std::memcpy(data_ + offset + sizeof(h), payload.data(), payload.size());
+    std::memcpy(data_ + offset, &h, sizeof(h));
+    end_ += bytes;
+    return offset;
+  }
+
+  void mark(sequence seq, kind k, state st) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    append(seq, 0, k, {});
+    entries_[seq].st = st;
+  }
+
+  std::string read(sequence seq, command_type &type) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return read_locked(seq, type);
+  }
+
+  // Requires mutex_.
+  std::string read_locked(sequence seq, command_type &type) const {
+    const std::size_t offset = entries_.at(seq).offset;
+    record_header h;
+    std::memcpy(&h, data_ + offset, sizeof(h));
+    type = h.type;
+    return std::string(data_ + offset + sizeof(h), h.size);
+  }
+
+  void scan() {
+    while (end_ + sizeof(record_header) <= capacity_) {
+      record_header h;
+      std::memcpy(&h, data_ + end_, sizeof(h));
+      if (end_ + sizeof(h) + h.size > capacity_ ||
+          h.checksum != checksum(h, data_ + end_ + sizeof(h)))
+        break;
+      switch (h.k) {
+      case kind::recorded:
+        if (h.seq != entries_.size())
+          return;
+        entries_.push_back({end_, state::pending});
+        break;
+      case kind::completed:
+      case kind::undone:
+        // A mark of a command never recorded is as corrupt as a bad
+        // checksum.
+        if (h.seq >= entries_.size())
+          return;
+        entries_[h.seq].st =
+            h.k == kind::completed ? state::completed : state::undone;
+        break;
+      default:
+        return;
+      }
+      end_ += padded(sizeof(h) + h.size);
+    }
+  }
+
+  int fd_ = -1;
+  char *data_ = nullptr;
+  std::size_t capacity_ = 0;
+  std::size_t end_ = 0;
+
+  mutable std::mutex mutex_;
+  std::condition_variable synced_;
+  bool syncing_ = false;
+  std::size_t durable_end_ = 0;
+
+  std::vector<entry> entries_;
+  std::map<command_type, type_handlers> types_;
+};
+
+#endif /* end of include guard: COMMAND_JOURNAL_H */
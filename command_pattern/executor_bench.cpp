@@ -0,0 +1,63 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "command_executor.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+/**
+ * Commands per second on 1, 2, 4 and all hardware threads: tiny commands
+ * submitted from outside the pool, commands submitted by commands, and
+ * chains of commands that each wait for the previous one.
+ */
+template <typename F> static double per_second(unsigned commands, F &&f) {
+  const auto start = std::chrono::steady_clock::now();
+  f();
+  const std::chrono::duration<double> d =
+      std::chrono::steady_clock::now() - start;
+  return commands / d.count();
+}
+
+int main() {
+  const unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+  std::cout << hardware << " hardware thread(s)\n";
+  for (unsigned threads : {1u, 2u, 4u, hardware}) {
+    command_executor executor(threads);
+    const command_kind TICK = executor.kind("tick");
+    const command_kind SPAWN = executor.kind("spawn");
+    std::atomic<unsigned> ticks{0};
+    auto tick = [&] { ticks.fetch_add(1, std::memory_order_relaxed); };
+
+    const double external = per_second(1000000, [&] {
+      for (unsigned i = 0; i < 1000000; ++i)
+        executor.submit(TICK, tick);
+      executor.wait();
+    });
+    const double nested = per_second(1001000, [&] {
+      for (unsigned i = 0; i < 1000; ++i)
+        executor.submit(SPAWN, [&] {
+          for (unsigned k = 0; k < 1000; ++k)
+            executor.submit(TICK, tick);
+        });
+      executor.wait();
+    });
+    const double chained = per_second(1000000, [&] {
+      // 100 chains of 10000, each command after the previous of its chain.
+      std::vector<command_id> last(100);
+      for (unsigned k = 0; k < 10000; ++k)
+        for (unsigned c = 0; c < 100; ++c)
+          last[c] = k == 0 ? executor.submit(TICK, tick)
+                           : executor.submit(TICK, tick,
+                                             command_priority::normal,
+                                             {last[c]});
+      executor.wait();
+    });
+    std::cout << threads << " thread(s): " << external << " submitted/s, "
+              << nested << " nested/s, " << chained << " chained/s\n";
+  }
+  return 0;
+}
@@ -0,0 +1,60 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "command_journal.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Journaled commands per second on local disk, for several group commit
+ * sizes and writer threads. Pass the directory for the journal as argument.
+ */
+static double commands_per_second(const std::string &path, unsigned threads,
+                                  unsigned commands, unsigned batch) {
+  ::unlink(path.c_str());
+  command_journal journal(path, 64 << 20);
+  journal.register_type(0, [](std::string_view) {});
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> writers;
+  for (unsigned t = 0; t < threads; ++t) {
+    writers.emplace_back([&] {
+      const std::string payload = "temperature=21.5;unit=C";
+      for (unsigned i = 1; i <= commands / threads; ++i) {
+        journal.execute(0, payload);
+        if (i % batch == 0)
+          journal.commit();
+      }
+      journal.commit();
+    });
+  }
+  for (auto &w : writers)
+    w.join();
+  std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+  ::unlink(path.c_str());
+  return commands / d.count();
+}
+
+int main(int argc, char *argv[]) {
+  const std::string path =
+      std::string(argc > 1 ? argv[1] : ".") + "/journal_bench.journal";
+  const unsigned commands = 1000000;
+
+  for (unsigned threads : {1u, 4u}) {
+    for (unsigned batch : {1000u, 10000u, 100000u}) {
+      std::cout << threads << " thread(s), commit every " << batch
+                << " commands: "
+                << commands_per_second(path, threads, commands, batch)
+                << " commands/s\n";
+    }
+  }
+  // One fdatasync per command is orders of magnitude slower; fewer commands
+  // keep the run short.
+  std::cout << "1 thread(s), commit every command: "
+            << commands_per_second(path, 1, 10000, 1) << " commands/s\n";
+  return 0;
+}
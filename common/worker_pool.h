@@ -0,0 +1,171 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+/**
+ * A pool of threads that run the jobs of one batch at a time; the calling
+ * thread is one of them. Threads take jobs in index order, so early jobs
+ * start first.
+ *
+ * A claim is the batch's generation and the next index in one atomic, so a
+ * worker that saw a batch late cannot claim an index of the next one: it
+ * only runs jobs of the batch it saw, while run() is still waiting for them.
+ *
+ * A job that throws still counts as done. run() waits for the whole batch
+ * and then rethrows the first exception.
+ */
+class worker_pool {
+public:
+  using job_type = std::function<void(std::size_t index, unsigned thread)>;
+
+  explicit worker_pool(
+      unsigned threads = std::max(1u, std::thread::hardware_concurrency())) {
+    try {
+      for (unsigned i = 1; i < threads; ++i)
+        workers_.emplace_back([this, i] { work(i); });
+    } catch (...) {
+      stop(); // the threads started so far
+      throw;
+    }
+  }
+
+  worker_pool(const worker_pool &) = delete;
+  worker_pool &operator=(const worker_pool &) = delete;
+
+  ~worker_pool() { stop(); }
+
+  /**
+   * Threads, including the calling one; job's thread is below this.
+   */
+  unsigned threads() const { return unsigned(workers_.size()) + 1; }
+
+  /**
+   * Call job(i, thread) for every i below count and return when all
+   * returned, rethrowing the first exception of a job. Not reentrant.
+   */
+  void run(std::size_t count, const job_type &job) {
+    if (count == 0)
+      return;
+    if (count > index_mask)
+      throw std::length_error("worker_pool: too many jobs");
+    std::uint32_t generation;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      job_ = &job;
+      count_ = count;
+      done_ = 0;
+      generation = ++generation_;
+      claim_.store(std::uint64_t(generation) << 32, std::memory_order_release);
+    }
+    wake_.notify_all();
+    take(job, count, generation, 0);
+    std::exception_ptr error;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      finished_.wait(lock, [&] { return done_ == count; });
+      job_ = nullptr;
+      std::swap(error, error_);
+    }
+    if (error)
+      std::rethrow_exception(error);
+  }
+
+private:
+  static constexpr std::uint64_t index_mask = 0xffffffffu;
+
+  /**
+   * Claim the next index of the given batch, if it has one left.
+   */
+  bool claim(std::uint32_t generation, std::size_t count, std::size_t &i) {
+    std::uint64_t c = claim_.load(std::memory_order_acquire);
+    while (c >> 32 == generation && (c & index_mask) < count) {
+      if (claim_.compare_exchange_weak(c, c + 1, std::memory_order_acq_rel,
+                                       std::memory_order_acquire)) {
+        i = c & index_mask;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void take(const job_type &job, std::size_t count, std::uint32_t generation,
+            unsigned thread) {
+    std::size_t done = 0;
+    std::exception_ptr error;
+    for (std::size_t i; claim(generation, count, i); ++done) {
+      try {
+        job(i, thread);
+      } catch (...) {
+        if (!error)
+          error = std::current_exception();
+      }
+    }
+    if (done > 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (error && !error_)
+        error_ = error;
+      done_ += done;
+      if (done_ == count)
+        finished_.notify_all();
+    }
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto &w : workers_)
+      w.join();
+  }
+
+  void work(unsigned thread) {
+    std::uint32_t seen = 0;
+    for (;;) {
+      const job_type *job;
+      std::size_t count;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+        if (stop_)
+          return;
+        seen = generation_;
+        job = job_;
+        count = count_;
+      }
+      if (job)
+        take(*job, count, seen, thread);
+    }
+  }
+
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable finished_;
+  const job_type *job_ = nullptr;
+  std::size_t count_ = 0;
+  std::size_t done_ = 0;
+  std::exception_ptr error_; // the batch's first
+  std::uint32_t generation_ = 0;
+  bool stop_ = false;
+  std::atomic<std::uint64_t> claim_{0}; // generation << 32 | next index
+};
+
+#endif /* end of include guard: WORKER_POOL_H */
@@ -0,0 +1,175 @@
+#ifndef COMBINATORS_H
+#define COMBINATORS_H
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief A function object returning a fixed value.
+ */
+template <class T> class Identity {
+public:
+  template <class U>
+  explicit constexpr Identity(U &&value) : value(std::forward<U>(value)) {}
+
+  constexpr const T &operator()() const { return value; }
+
+private:
+  T value;
+};
+
+template <class F, class... Args> struct Partial;
+
+template <class... Fs> struct Composed;
+
+namespace detail {
+
+template <class T> struct IsPartial : std::false_type {};
+template <class F, class... Args>
+struct IsPartial<Partial<F, Args...>> : std::true_type {};
+
+template <class T> struct IsComposed : std::false_type {};
+template <class... Fs>
+struct IsComposed<Composed<Fs...>> : std::true_type {};
+
+template <class T> using Plain = std::decay_t<T>;
+
+} // namespace detail
+
+/**
+ * @brief A function with its first arguments bound.
+ *
+ * Bound arguments are stored once and passed on as lvalues; the remaining
+ * arguments are forwarded as they come. The result is returned by value, as
+ * a reference into a bound argument or a temporary would dangle; a function
+ * that means to return a reference returns a std::reference_wrapper.
+ */
+template <class F, class... Args> struct Partial {
+  F f;
+  std::tuple<Args...> args;
+
+  template <class G, class... As>
+  constexpr Partial(std::in_place_t, G &&f, As &&... args)
+      : f(std::forward<G>(f)), args(std::forward<As>(args)...) {}
+
+  template <class... Rest>
+  constexpr auto operator()(Rest &&... rest) const {
+    return call(std::index_sequence_for<Args...>(),
+                std::forward<Rest>(rest)...);
+  }
+
+private:
+  template <std::size_t... I, class... Rest>
+  constexpr auto call(std::index_sequence<I...>, Rest &&... rest) const {
+    return f(std::get<I>(args)..., std::forward<Rest>(rest)...);
+  }
+};
+
+/**
+ * @brief Functions composed to the form fs[0](fs[1](...fs[n](args...))).
+ *
+ * The functions are held side by side, not nested, and the arguments are
+ * forwarded to the innermost one. Every result is returned by value, like
+ * Partial's.
+ */
+template <class... Fs> struct Composed {
+  static_assert(sizeof...(Fs) >= 2, "compose at least two functions");
+
+  std::tuple<Fs...> fs;
+
+  template <class... Gs>
+  constexpr Composed(std::in_place_t, Gs &&... fs)
+      : fs(std::forward<Gs>(fs)...) {}
+
+  template <class... Args>
+  constexpr auto operator()(Args &&... args) const {
+    return call<0>(std::forward<Args>(args)...);
+  }
+
+private:
+  template <std::size_t I, class... Args>
+  constexpr auto call(Args &&... args) const {
+    if constexpr (I + 1 == sizeof...(Fs))
+      return std::get<I>(fs)(std::forward<Args>(args)...);
+    else
+      return std::get<I>(fs)(call<I + 1>(std::forward<Args>(args)...));
+  }
+};
+
+namespace detail {
+
+// A composition contributes its functions, anything else itself.
+template <class F> constexpr auto flatten(F &&f) {
+  if constexpr (IsComposed<Plain<F>>::value)
+    return std::forward<F>(f).fs;
+  else
+    return std::tuple<Plain<F>>(std::forward<F>(f));
+}
+
+template <class... Fs>
+constexpr Composed<Fs...> makeComposed(std::tuple<Fs...> &&fs) {
+  return std::apply(
+      [](auto &&... f) {
+        return Composed<Fs...>(std::in_place,
+                               std::forward<decltype(f)>(f)...);
+      },
+      std::move(fs));
+}
+
+} // namespace detail
+
+/**
+ * @brief Makes a function object from a value of type T.
+ * @param id Some value of type T.
+ */
+template <class T> constexpr auto identity(T &&id) {
+  return Identity<detail::Plain<T>>(std::forward<T>(id));
+}
+
+/**
+ * @brief Creates a function from a partially applied function. Partially
+ * applying a partial application binds all arguments in one object.
+ *
+ * @param f Function to be partially applied.
+ * @param args Arguments of the partial application.
+ */
+template <class F, class... Args>
+constexpr auto partialapply(F &&f, Args &&... args) {
+  using G = detail::Plain<F>;
+  if constexpr (detail::IsPartial<G>::value) {
+    return std::apply(
+        [&](auto &&g, auto &&... bound) {
+          return Partial<std::decay_t<decltype(g)>,
+                         std::decay_t<decltype(bound)>...,
+                         detail::Plain<Args>...>(
+              std::in_place, std::forward<decltype(g)>(g),
+              std::forward<decltype(bound)>(bound)...,
+              std::forward<Args>(args)...);
+        },
+        std::tuple_cat(std::forward_as_tuple(std::forward<F>(f).f),
+                       std::forward<F>(f).args));
+  } else {
+    return Partial<G, detail::Plain<Args>...>(
+        std::in_place, std::forward<F>(f), std::forward<Args>(args)...);
+  }
+}
+
+/**
+ * @brief Compose functions to the form first(second(rest(...))). Compositions
+ * among them are flattened, so compose(f, compose(g, h)) is compose(f, g, h).
+ *
+ * @param first First function to be composed.
+ * @param second Second function to be composed.
+ * @param rest All other functions to be composed.
+ */
+template <class First, class Second, class... Rest>
+constexpr auto compose(First &&first, Second &&second, Rest &&... rest) {
+  return detail::makeComposed(
+      std::tuple_cat(detail::flatten(std::forward<First>(first)),
+                     detail::flatten(std::forward<Second>(second)),
+                     detail::flatten(std::forward<Rest>(rest))...));
+}
+
+#endif /* end of include guard: COMBINATORS_H */
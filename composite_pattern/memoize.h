@@ -0,0 +1,177 @@
+#ifndef MEMOIZE_H
+#define MEMOIZE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+template <class Signature, class F> class Memoized;
+
+/**
+ * @brief Hit and miss counts of a memoized function.
+ */
+struct MemoStats {
+  std::uint64_t hits = 0;
+  std::uint64_t misses = 0;
+  std::uint64_t evictions = 0;
+};
+
+/**
+ * @brief A function decorated with a cache of its results.
+ *
+ * The cache is split into shards, each with its own lock, so concurrent
+ * callers mostly take different locks. Every shard holds at most its share
+ * of the capacity and evicts with the CLOCK algorithm: a hit only sets a
+ * bit, and on a miss the clock hand clears bits until it finds an entry not
+ * used since its last turn.
+ *
+ * The function runs outside the lock, so it is assumed to be pure; two
+ * threads missing on the same arguments at once both compute it. Copies of
+ * a Memoized share one cache.
+ */
+template <class R, class... Args, class F> class Memoized<R(Args...), F> {
+public:
+  using Key = std::tuple<std::decay_t<Args>...>;
+
+  template <class G>
+  Memoized(G &&f, std::size_t capacity, std::size_t shards)
+      : cache(std::make_shared<Cache>(std::forward<G>(f), capacity, shards)) {}
+
+  R operator()(Args... args) const {
+    Key key(args...);
+    const std::size_t hash = Hash()(key);
+    Shard &shard = cache->shard(hash);
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      auto it = shard.index.find(key);
+      if (it != shard.index.end()) {
+        Entry &e = shard.entries[it->second];
+        e.referenced = true;
+        ++shard.hits;
+        return e.value;
+      }
+    }
+    R value = cache->f(std::forward<Args>(args)...);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    ++shard.misses;
+    if (shard.index.find(key) == shard.index.end())
+      shard.insert(std::move(key), value, cache->shardCapacity);
+    return value;
+  }
+
+  MemoStats stats() const {
+    MemoStats s;
+    for (Shard &shard : cache->shards) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      s.hits += shard.hits;
+      s.misses += shard.misses;
+      s.evictions += shard.evictions;
+    }
+    return s;
+  }
+
+private:
+  struct Hash {
+    std::size_t operator()(const Key &key) const {
+      return std::apply(
+          [](const auto &... x) {
+            std::size_t h = 0;
+            ((h ^= std::hash<std::decay_t<decltype(x)>>()(x) +
+                   0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2)),
+             ...);
+            return h;
+          },
+          key);
+    }
+  };
+
+  struct Entry {
+    Key key;
+    R value;
+    bool referenced;
+  };
+
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<Key, std::size_t, Hash> index;
+    std::vector<Entry> entries;
+    std::size_t hand = 0;
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t evictions = 0;
+
+    void insert(Key key, const R &value, std::size_t capacity) {
+      if (entries.size() < capacity) {
+        index.emplace(key, entries.size());
+        entries.push_back({std::move(key), value, false});
+        return;
+      }
+      while (entries[hand].referenced) {
+        entries[hand].referenced = false;
+        hand = (hand + 1) % entries.size();
+      }
+      Entry &victim = entries[hand];
+      index.erase(victim.key);
+      index.emplace(key, hand);
+      victim = {std::move(key), value, false};
+      hand = (hand + 1) % entries.size();
+      ++evictions;
+    }
+  };
+
+  struct Cache {
+    F f;
+    std::vector<Shard> shards;
+    std::size_t shardCapacity;
+
+    template <class G>
+    Cache(G &&f, std::size_t capacity, std::size_t count)
+        : f(std::forward<G>(f)), shards(roundUp(count)),
+          shardCapacity(std::max<std::size_t>(1, capacity / shards.size())) {
+    }
+
+    Shard &shard(std::size_t hash) {
+      // std::hash of an integer is often the integer itself; mix all bits
+      // into the top ones, which pick the shard.
+      std::uint64_t h = hash;
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdull;
+      h ^= h >> 33;
+      return shards[(h >> 48) & (shards.size() - 1)];
+    }
+
+    static std::size_t roundUp(std::size_t n) {
+      std::size_t r = 1;
+      while (r < n)
+        r <<= 1;
+      return r;
+    }
+  };
+
+  std::shared_ptr<Cache> cache;
+};
+
+/**
+ * @brief Decorates a function--composed, partially applied or plain--with a
+ * cache of its results.
+ *
+ * @param f Function to be memoized; pure, with hashable arguments.
+ * @param capacity Maximum number of cached results.
+ * @param shards Number of independently locked parts of the cache.
+ */
+template <class Signature, class F>
+Memoized<Signature, std::decay_t<F>> memoize(F &&f,
+                                             std::size_t capacity = 1 << 16,
+                                             std::size_t shards = 16) {
+  return {std::forward<F>(f), capacity, shards};
+}
+
+#endif /* end of include guard: MEMOIZE_H */
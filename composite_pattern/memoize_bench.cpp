@@ -0,0 +1,68 @@
+#include "combinators.h"
+#include "memoize.h"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+/*
+ * A composition of an expensive pure stage, called with arguments drawn from
+ * a few thousand values, plain and memoized, on 1, 2, 4, ... threads up to
+ * the number of cores. Build with
+ *
+ *      g++ -std=c++17 -O2 -pthread memoize_bench.cpp
+ */
+static double expensive(int x) {
+  double r = x;
+  for (int i = 0; i < 2000; ++i)
+    r = std::sqrt(r * r + i);
+  return r;
+}
+
+static double scale(double x) { return x * 0.5; }
+
+template <class F>
+static double callsPerSecond(unsigned threads, std::size_t calls, F &f) {
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      std::uint32_t x = 2463534242u + t;
+      double sink = 0;
+      for (std::size_t i = 0; i < calls / threads; ++i) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        // Mostly a few hundred hot values, sometimes one of 4096.
+        sink += f(x % 8 ? x % 256 : (x >> 3) % 4096);
+      }
+      if (sink == 0)
+        std::cout << "";
+    });
+  }
+  for (auto &w : workers)
+    w.join();
+  std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+  return calls / d.count();
+}
+
+int main() {
+  const std::size_t calls = 2000000;
+  auto pipeline = compose(scale, expensive);
+
+  const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned threads = 1; threads <= cores; threads *= 2) {
+    // Room for half of the values, so eviction takes part.
+    auto cached = memoize<double(int)>(pipeline, 2048, 16);
+    const double plain = callsPerSecond(threads, calls / 20, pipeline);
+    const double memoized = callsPerSecond(threads, calls, cached);
+    const MemoStats s = cached.stats();
+    std::cout << threads << " thread(s): plain " << plain
+              << " calls/s, memoized " << memoized << " calls/s ("
+              << memoized / plain << "x; " << s.hits << " hits, " << s.misses
+              << " misses, " << s.evictions << " evictions)\n";
+  }
+  return 0;
+}
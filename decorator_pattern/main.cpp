@@ -1,3 +1,4 @@
+#include "simd_ranges.h"
 #include <iostream>
 #include <range/v3/view/filter.hpp>
 #include <range/v3/view/single.hpp>
@@ -12,4 +13,9 @@ int main() {
       ranges::views::zip_with([](int a, int b) { return a & b; }, v1, v2);
 
   std::cout << rng << std::endl;
+
+  // The same decoration, evaluated in blocks.
+  std::cout << simd_ranges::zip_with([](int a, int b) { return a & b; }, v1,
+                                     simd_ranges::single(9))
+            << std::endl;
 }
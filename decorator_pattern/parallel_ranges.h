@@ -0,0 +1,182 @@
+#ifndef PARALLEL_RANGES_H
+#define PARALLEL_RANGES_H
+
+#include "../common/worker_pool.h"
+#include "simd_ranges.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/*
+ * Runs simd_ranges pipelines over random-access sources on a pool of
+ * threads. The source is split into chunks of `chunk` elements, small enough
+ * for every stage's working set to stay in cache; threads take chunks in
+ * turn, each running its own copy of the pipeline over its chunk.
+ */
+namespace simd_ranges {
+
+class parallel_executor {
+public:
+  explicit parallel_executor(
+      unsigned threads = std::max(1u, std::thread::hardware_concurrency()),
+      std::size_t chunk = 1 << 15)
+      : m_chunk(std::max(chunk, block)), m_pool(threads) {}
+
+  std::size_t chunk() const { return m_chunk; }
+  unsigned threads() const { return m_pool.threads(); }
+
+  /*
+   * The number of chunks of [0, n). An unbounded source (size SIZE_MAX, as a
+   * bare repeat) has no end to split, so it is refused; zipped with a bounded
+   * one, it is fine.
+   */
+  std::size_t chunks(std::size_t n) const {
+    if (n == SIZE_MAX)
+      throw std::length_error("parallel_executor: unbounded source");
+    return n / m_chunk + (n % m_chunk != 0);
+  }
+
+  /*
+   * Call f(c, first, last) for every chunk c of [0, n) and return when all
+   * are done; the calling thread is one of the threads. Not reentrant.
+   */
+  template <class F> void for_each_chunk(std::size_t n, F &&f) {
+    m_pool.run(chunks(n), [&](std::size_t c, unsigned) {
+      const std::size_t first = c * m_chunk;
+      f(c, first, std::min(n, first + m_chunk));
+    });
+  }
+
+private:
+  const std::size_t m_chunk;
+  worker_pool m_pool;
+};
+
+namespace detail {
+
+template <class T> struct IsFilter : std::false_type {};
+template <class P> struct IsFilter<filter_stage<P>> : std::true_type {};
+
+template <class P> struct HasFilter;
+template <class S, class... Stages>
+struct HasFilter<pipeline<S, Stages...>>
+    : std::disjunction<IsFilter<Stages>...> {};
+
+} // namespace detail
+
+/*
+ * A reduction in parallel. op must be associative: every chunk is reduced
+ * on its own, starting from its first element, and the chunks' results are
+ * combined in order onto init, so the result does not depend on the number
+ * of threads.
+ */
+template <class P, class T, class Op>
+T reduce(parallel_executor &executor, const P &p, T init, Op op) {
+  const std::size_t n = p.source.size();
+  std::vector<T> partial(executor.chunks(n), init);
+  std::vector<char> nonempty(partial.size(), 0);
+  executor.for_each_chunk(n, [&](std::size_t c, std::size_t first,
+                                 std::size_t last) {
+    T acc = init;
+    bool seeded = false;
+    const P local = p;
+    local.run(first, last, [&](const auto *values, std::size_t count) {
+      std::size_t i = 0;
+      if (!seeded && count > 0) {
+        acc = T(values[i++]);
+        seeded = true;
+      }
+      for (; i < count; ++i)
+        acc = op(acc, values[i]);
+    });
+    partial[c] = acc;
+    nonempty[c] = seeded;
+  });
+  for (std::size_t c = 0; c < partial.size(); ++c) {
+    if (nonempty[c])
+      init = op(init, partial[c]);
+  }
+  return init;
+}
+
+template <class P>
+typename P::value_type sum(parallel_executor &executor, const P &p) {
+  using V = typename P::value_type;
+  const std::size_t n = p.source.size();
+  std::vector<V> partial(executor.chunks(n));
+  executor.for_each_chunk(n, [&](std::size_t c, std::size_t first,
+                                 std::size_t last) {
+    const P local = p;
+    V lanes[16] = {};
+    local.run(first, last, [&](const V *values, std::size_t count) {
+      std::size_t i = 0;
+      for (; i + 16 <= count; i += 16) {
+        for (std::size_t l = 0; l < 16; ++l)
+          lanes[l] += values[i + l];
+      }
+      for (; i < count; ++i)
+        lanes[0] += values[i];
+    });
+    V r{};
+    for (V v : lanes)
+      r += v;
+    partial[c] = r;
+  });
+  V r{};
+  for (V v : partial)
+    r += v;
+  return r;
+}
+
+/*
+ * Write the results in order to out, which has room for one result per
+ * source element. Returns how many were written.
+ *
+ * Without filters, every chunk knows where its results go and writes them
+ * there directly. With filters, chunks collect into their own buffers
+ * first, and are copied into place in parallel once their offsets are
+ * known.
+ */
+template <class P>
+std::size_t collect(parallel_executor &executor, const P &p,
+                    typename P::value_type *out) {
+  using V = typename P::value_type;
+  const std::size_t n = p.source.size();
+  if constexpr (!detail::HasFilter<P>::value) {
+    executor.for_each_chunk(n, [&](std::size_t, std::size_t first,
+                                   std::size_t last) {
+      const P local = p;
+      V *to = out + first;
+      local.run(first, last, [&](const V *values, std::size_t count) {
+        to = std::copy_n(values, count, to);
+      });
+    });
+    return n;
+  } else {
+    std::vector<std::vector<V>> parts(executor.chunks(n));
+    executor.for_each_chunk(n, [&](std::size_t c, std::size_t first,
+                                   std::size_t last) {
+      const P local = p;
+      std::vector<V> &part = parts[c];
+      part.reserve(last - first);
+      local.run(first, last, [&](const V *values, std::size_t count) {
+        part.insert(part.end(), values, values + count);
+      });
+    });
+    std::vector<std::size_t> offset(parts.size() + 1, 0);
+    for (std::size_t c = 0; c < parts.size(); ++c)
+      offset[c + 1] = offset[c] + parts[c].size();
+    executor.for_each_chunk(n, [&](std::size_t c, std::size_t, std::size_t) {
+      std::copy(parts[c].begin(), parts[c].end(), out + offset[c]);
+    });
+    return offset.back();
+  }
+}
+
+} // namespace simd_ranges
+
+#endif /* end of include guard: PARALLEL_RANGES_H */
@@ -0,0 +1,59 @@
+#include "parallel_ranges.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+/*
+ * zip_with(&) | transform(*3) over 100M ints on 1, 2, 4, ... threads up to
+ * the number of cores: a parallel sum, an order-preserving collect into a
+ * preallocated output, and the same collect with a filter. Build with
+ *
+ *      g++ -std=c++17 -O3 -march=native -pthread parallel_ranges_bench.cpp
+ *
+ * The number of ints can be given as argument.
+ */
+template <class F> static double seconds(F &&f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+  return d.count();
+}
+
+int main(int argc, char *argv[]) {
+  using namespace simd_ranges;
+  const std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10)
+                                 : 100000000;
+  std::vector<int> a(n), b(n);
+  std::uint32_t x = 2463534242u;
+  for (std::size_t i = 0; i < n; ++i) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    a[i] = x & 0xffff;
+    b[i] = x >> 16;
+  }
+  std::vector<std::int64_t> out(n);
+
+  auto pipe = zip_with([](int l, int r) { return l & r; }, a, b) |
+              transform([](int v) { return std::int64_t(v) * 3; });
+  auto filtered = pipe | filter([](std::int64_t v) { return v & 1; });
+
+  const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned threads = 1; threads <= cores; threads *= 2) {
+    parallel_executor executor(threads);
+    std::int64_t total = 0;
+    std::size_t kept = 0;
+    const double s = seconds([&] { total = sum(executor, pipe); });
+    const double c = seconds([&] { collect(executor, pipe, out.data()); });
+    const double f =
+        seconds([&] { kept = collect(executor, filtered, out.data()); });
+    std::cout << threads << " thread(s): sum " << n / s / 1e6
+              << " M ints/s, collect " << n / c / 1e6
+              << " M ints/s, filtered collect " << n / f / 1e6
+              << " M ints/s (" << total << ", " << kept << " kept)\n";
+  }
+  return 0;
+}
@@ -0,0 +1,344 @@
+#ifndef SIMD_RANGES_H
+#define SIMD_RANGES_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <ostream>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#ifdef __AVX512F__
+#include <immintrin.h>
+#endif
+
+/*
+ * Range adaptors that decorate a source the way range-v3 views do--zip_with,
+ * transform, filter--but run in blocks instead of one element at a time.
+ *
+ * A pipeline pulls its source in blocks of `block` elements. Each stage turns
+ * a whole block into the next one with a plain loop over arrays, which the
+ * compiler vectorizes, and a sink (reduction, collection) consumes the last.
+ * Contiguous ranges of arithmetic values are read in place; any other range,
+ * such as a std::list or a range-v3 view, is read through its iterators,
+ * element by element, with the same results.
+ *
+ * Sources are non-owning like views, except single(), which holds its value.
+ */
+namespace simd_ranges {
+
+constexpr std::size_t block = 256;
+
+namespace detail {
+
+template <class R, class = void> struct IsContiguous : std::false_type {};
+template <class R>
+struct IsContiguous<R, std::void_t<decltype(std::data(std::declval<R &>())),
+                                   decltype(std::size(std::declval<R &>()))>>
+    : std::is_arithmetic<
+          std::remove_cv_t<std::remove_pointer_t<decltype(std::data(
+              std::declval<R &>()))>>> {};
+
+} // namespace detail
+
+/* A contiguous array of arithmetic values, read in place. */
+template <class T> struct contiguous_source {
+  using value_type = T;
+
+  const T *data;
+  std::size_t n;
+
+  std::size_t size() const { return n; }
+  const T *fetch(std::size_t at, std::size_t, T *) const { return data + at; }
+};
+
+/* Any other range, copied out through its iterators one element at a time. */
+template <class It> struct iterator_source {
+  using value_type = std::decay_t<decltype(*std::declval<It>())>;
+
+  It first;
+  std::size_t n;
+  // Blocks are fetched in order, so a forward iterator suffices.
+  mutable It cursor = first;
+  mutable std::size_t position = 0;
+
+  std::size_t size() const { return n; }
+  const value_type *fetch(std::size_t at, std::size_t count,
+                          value_type *out) const {
+    if (at < position) {
+      cursor = first;
+      position = 0;
+    }
+    std::advance(cursor, at - position);
+    for (std::size_t i = 0; i < count; ++i, ++cursor)
+      out[i] = *cursor;
+    position = at + count;
+    return out;
+  }
+};
+
+/* A range of one element, as range-v3's views::single. */
+template <class T> struct single_source {
+  using value_type = T;
+
+  T value;
+
+  std::size_t size() const { return 1; }
+  const T *fetch(std::size_t, std::size_t, T *) const { return &value; }
+};
+
+template <class T> single_source<T> single(T value) { return {value}; }
+
+/* One value, endlessly, as range-v3's views::repeat. */
+template <class T> struct repeat_source {
+  using value_type = T;
+
+  T value;
+
+  std::size_t size() const { return SIZE_MAX; }
+  const T *fetch(std::size_t, std::size_t count, T *out) const {
+    std::fill_n(out, count, value);
+    return out;
+  }
+};
+
+template <class T> repeat_source<T> repeat(T value) { return {value}; }
+
+template <class S, class = void> struct IsSource : std::false_type {};
+template <class S>
+struct IsSource<
+    S, std::void_t<decltype(std::declval<const S &>().fetch(
+           0, 0, std::declval<typename S::value_type *>()))>>
+    : std::true_type {};
+
+/* The source for a range: itself if it is one, else contiguous or not. */
+template <class R> auto as_source(const R &r) {
+  if constexpr (IsSource<R>::value) {
+    return r;
+  } else if constexpr (detail::IsContiguous<const R>::value) {
+    using T = std::remove_cv_t<std::remove_pointer_t<decltype(std::data(r))>>;
+    return contiguous_source<T>{std::data(r), std::size(r)};
+  } else {
+    using It = decltype(std::begin(r));
+    return iterator_source<It>{
+        std::begin(r),
+        static_cast<std::size_t>(std::distance(std::begin(r), std::end(r)))};
+  }
+}
+
+/* f applied pairwise to two sources, as long as the shorter one lasts. */
+template <class F, class A, class B> struct zip_source {
+  using value_type =
+      std::decay_t<std::invoke_result_t<const F &, typename A::value_type,
+                                        typename B::value_type>>;
+
+  F f;
+  A a;
+  B b;
+
+  std::size_t size() const { return std::min(a.size(), b.size()); }
+
+  const value_type *fetch(std::size_t at, std::size_t count,
+                          value_type *out) const {
+    alignas(64) typename A::value_type bufferA[block];
+    alignas(64) typename B::value_type bufferB[block];
+    const auto *x = a.fetch(at, count, bufferA);
+    const auto *y = b.fetch(at, count, bufferB);
+    for (std::size_t i = 0; i < count; ++i)
+      out[i] = f(x[i], y[i]);
+    return out;
+  }
+};
+
+template <class F> struct transform_stage {
+  F f;
+
+  template <class V>
+  using result = std::decay_t<std::invoke_result_t<const F &, V>>;
+
+  template <class V, class U>
+  std::size_t operator()(const V *in, std::size_t n, U *out) const {
+    for (std::size_t i = 0; i < n; ++i)
+      out[i] = f(in[i]);
+    return n;
+  }
+};
+
+template <class P> struct filter_stage {
+  P p;
+
+  template <class V> using result = V;
+
+  /*
+   * Compress the block: the predicate runs over the whole block into a mask
+   * first, then the kept elements are stored--with AVX-512 compress stores
+   * for 32-bit values, else with a branchless loop.
+   */
+  template <class V>
+  std::size_t operator()(const V *in, std::size_t n, V *out) const {
+    alignas(64) std::uint8_t keep[block];
+    for (std::size_t i = 0; i < n; ++i)
+      keep[i] = p(in[i]) ? 1 : 0;
+    std::size_t i = 0, m = 0;
+#ifdef __AVX512F__
+    if constexpr (sizeof(V) == 4 && std::is_integral_v<V>) {
+      for (; i + 16 <= n; i += 16) {
+        const __mmask16 mask = _mm_movemask_epi8(_mm_cmpgt_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(keep + i)),
+            _mm_setzero_si128()));
+        _mm512_mask_compressstoreu_epi32(out + m, mask,
+                                         _mm512_loadu_si512(in + i));
+        m += __builtin_popcount(mask);
+      }
+    }
+#endif
+    for (; i < n; ++i) {
+      out[m] = in[i];
+      m += keep[i];
+    }
+    return m;
+  }
+};
+
+template <class F> transform_stage<F> transform(F f) { return {std::move(f)}; }
+template <class P> filter_stage<P> filter(P p) { return {std::move(p)}; }
+
+/*
+ * A source decorated with stages, evaluated only by a sink.
+ */
+namespace detail {
+
+template <class V, class... Stages> struct ResultOf { using type = V; };
+template <class V, class Stage, class... Stages>
+struct ResultOf<V, Stage, Stages...>
+    : ResultOf<typename Stage::template result<V>, Stages...> {};
+
+} // namespace detail
+
+template <class Source, class... Stages> struct pipeline {
+  using value_type =
+      typename detail::ResultOf<typename Source::value_type, Stages...>::type;
+
+  Source source;
+  std::tuple<Stages...> stages;
+
+  /*
+   * Call sink(values, count) with consecutive blocks of the result.
+   */
+  template <class Sink> void run(Sink &&sink) const {
+    run(0, source.size(), sink);
+  }
+
+  /*
+   * The same, for the source elements in [first, last) only.
+   */
+  template <class Sink>
+  void run(std::size_t first, std::size_t last, Sink &&sink) const {
+    using V = typename Source::value_type;
+    alignas(64) V buffer[block];
+    for (std::size_t at = first; at < last; at += block) {
+      const std::size_t count = std::min(block, last - at);
+      apply<0>(source.fetch(at, count, buffer), count, sink);
+    }
+  }
+
+private:
+  template <std::size_t I, class V, class Sink>
+  void apply(const V *in, std::size_t n, Sink &sink) const {
+    if constexpr (I == sizeof...(Stages)) {
+      sink(in, n);
+    } else {
+      const auto &stage = std::get<I>(stages);
+      using U = typename std::decay_t<decltype(stage)>::template result<V>;
+      alignas(64) U out[block];
+      apply<I + 1>(out, stage(in, n, out), sink);
+    }
+  }
+};
+
+template <class R> auto from(const R &r) {
+  return pipeline<decltype(as_source(r))>{as_source(r), {}};
+}
+
+template <class S, class... Stages, class F>
+pipeline<S, Stages..., transform_stage<F>>
+operator|(pipeline<S, Stages...> p, transform_stage<F> t) {
+  return {std::move(p.source),
+          std::tuple_cat(std::move(p.stages), std::make_tuple(std::move(t)))};
+}
+
+template <class S, class... Stages, class P>
+pipeline<S, Stages..., filter_stage<P>>
+operator|(pipeline<S, Stages...> p, filter_stage<P> f) {
+  return {std::move(p.source),
+          std::tuple_cat(std::move(p.stages), std::make_tuple(std::move(f)))};
+}
+
+template <class F, class A, class B>
+auto zip_with(F f, const A &a, const B &b) {
+  using Zip = zip_source<F, decltype(as_source(a)), decltype(as_source(b))>;
+  return pipeline<Zip>{Zip{std::move(f), as_source(a), as_source(b)}, {}};
+}
+
+/*
+ * Sinks.
+ */
+template <class P, class T, class Op> T reduce(const P &p, T init, Op op) {
+  p.run([&](const auto *values, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i)
+      init = op(init, values[i]);
+  });
+  return init;
+}
+
+/* A sum over 16 independent lanes, so it vectorizes for floats too. */
+template <class P> typename P::value_type sum(const P &p) {
+  using V = typename P::value_type;
+  constexpr std::size_t lanes = 16;
+  V partial[lanes] = {};
+  p.run([&](const V *values, std::size_t n) {
+    std::size_t i = 0;
+    for (; i + lanes <= n; i += lanes) {
+      for (std::size_t l = 0; l < lanes; ++l)
+        partial[l] += values[i + l];
+    }
+    for (; i < n; ++i)
+      partial[0] += values[i];
+  });
+  V r{};
+  for (V v : partial)
+    r += v;
+  return r;
+}
+
+template <class P> std::size_t count(const P &p) {
+  std::size_t r = 0;
+  p.run([&](const auto *, std::size_t n) { r += n; });
+  return r;
+}
+
+template <class P> std::vector<typename P::value_type> to_vector(const P &p) {
+  std::vector<typename P::value_type> r;
+  p.run([&](const auto *values, std::size_t n) {
+    r.insert(r.end(), values, values + n);
+  });
+  return r;
+}
+
+/* Printed as range-v3 prints ranges: [1,2,3] */
+template <class S, class... Stages>
+std::ostream &operator<<(std::ostream &os, const pipeline<S, Stages...> &p) {
+  const char *separator = "";
+  os << '[';
+  p.run([&](const auto *values, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i, separator = ",")
+      os << separator << values[i];
+  });
+  return os << ']';
+}
+
+} // namespace simd_ranges
+
+#endif /* end of include guard: SIMD_RANGES_H */
@@ -0,0 +1,73 @@
+#include "simd_ranges.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#if __has_include(<range/v3/numeric/accumulate.hpp>)
+#include <range/v3/numeric/accumulate.hpp>
+#include <range/v3/view/filter.hpp>
+#include <range/v3/view/transform.hpp>
+#include <range/v3/view/zip_with.hpp>
+#define HAVE_RANGE_V3 1
+#endif
+
+/*
+ * zip_with(&) | filter(odd) | transform(*3) | sum over 100M ints, with
+ * simd_ranges and with range-v3 (or, without range-v3, the element at a
+ * time loop its views boil down to). Build with
+ *
+ *      g++ -std=c++17 -O3 -march=native simd_ranges_bench.cpp
+ *
+ * The number of ints can be given as argument.
+ */
+template <class F> static void report(const char *name, std::size_t n, F &&f) {
+  auto start = std::chrono::steady_clock::now();
+  const std::int64_t result = f();
+  std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+  std::cout << name << ": " << n / d.count() / 1e6 << " M ints/s (" << result
+            << ")\n";
+}
+
+int main(int argc, char *argv[]) {
+  const std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10)
+                                 : 100000000;
+  std::vector<int> a(n), b(n);
+  std::uint32_t x = 2463534242u;
+  for (std::size_t i = 0; i < n; ++i) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    a[i] = x & 0xffff;
+    b[i] = x >> 16;
+  }
+
+  auto both = [](int l, int r) { return l & r; };
+  auto odd = [](int v) { return (v & 1) != 0; };
+  auto triple = [](int v) { return std::int64_t(v) * 3; };
+
+#ifdef HAVE_RANGE_V3
+  report("range-v3", n, [&] {
+    return ranges::accumulate(ranges::views::zip_with(both, a, b) |
+                                  ranges::views::filter(odd) |
+                                  ranges::views::transform(triple),
+                              std::int64_t(0));
+  });
+#else
+  report("element at a time", n, [&] {
+    std::int64_t sum = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+      const int v = both(a[i], b[i]);
+      if (odd(v))
+        sum += triple(v);
+    }
+    return sum;
+  });
+#endif
+
+  report("simd_ranges", n, [&] {
+    using namespace simd_ranges;
+    return sum(zip_with(both, a, b) | filter(odd) | transform(triple));
+  });
+  return 0;
+}
@@ -0,0 +1,161 @@
+#ifndef COMPOSITION_H
+#define COMPOSITION_H
+
+/*
+ * Partial application and function composition.
+ *
+ * Both used to be recursive: PartialApplication<F,X1,X2> was a
+ * PartialApplication<PartialApplication<F,X1>,X2>, and Composition<F,G,H> a
+ * Composition<F,Composition<G,H>>. Deep compositions made deeply nested
+ * types, long compile times and call chains the optimizer did not always
+ * inline. Here each is one flat object backed by a tuple, with a single
+ * operator() that expands an index sequence.
+ */
+
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+template <class...> struct PartialApplication;
+
+template <class F, class X, class... Xs>
+struct PartialApplication<F, X, Xs...> {
+  F f;
+  std::tuple<X, Xs...> xs;
+
+  template <class _F, class _X, class... _Xs,
+            class = typename std::enable_if<sizeof...(_Xs) ==
+                                            sizeof...(Xs)>::type>
+  constexpr PartialApplication(_F &&f, _X &&x, _Xs &&... xs)
+      : f(std::forward<_F>(f)),
+        xs(std::forward<_X>(x), std::forward<_Xs>(xs)...) {}
+
+private:
+  template <std::size_t... I, class... Ys>
+  constexpr auto call(std::index_sequence<I...>, Ys &&... ys)
+      -> decltype(f(std::get<I>(xs)..., std::declval<Ys>()...)) {
+    return f(std::get<I>(xs)..., std::forward<Ys>(ys)...);
+  }
+
+public:
+  /*
+   * The return type of F only gets deduced based on the number of arguments
+   * supplied. PartialApplication otherwise has no idea whether f takes 1 or 10
+   * xs.
+   */
+  template <class... Ys>
+  constexpr auto operator()(Ys &&... ys)
+      -> decltype(call(std::index_sequence_for<X, Xs...>(),
+                       std::declval<Ys>()...)) {
+    return call(std::index_sequence_for<X, Xs...>(), std::forward<Ys>(ys)...);
+  }
+};
+
+/*
+ * Some languages implement partial application through closures, which hold
+ * references to the function's arguments. But they also often use reference
+ * counting. We must consider the scope of the variables we want to apply. If
+ * we apply references and then return the applied function, its references
+ * will dangle.
+ *
+ * See:
+ * upward funarg problem http://en.wikipedia.org/wiki/Upward_funarg_problem
+ */
+
+/*
+ * closure http://en.wikipedia.org/wiki/Closure_%28computer_science%29
+ * Here, closure forwards the arguments, which may be references or rvalues--it
+ * does not matter. A regular closure works for passing functions down.
+ */
+template <class F, class... X>
+constexpr PartialApplication<F, X...> closure(F &&f, X &&... x) {
+  return PartialApplication<F, X...>(std::forward<F>(f), std::forward<X>(x)...);
+}
+
+/*
+ * Thinking as closures as open (having references to variables outside of
+ * itself), let's refer to a closet as closed. It contains a function and its
+ * arguments (or environment).
+ */
+template <class F, class... X>
+constexpr PartialApplication<F, X...> closet(F f, X... x) {
+  return PartialApplication<F, X...>(std::move(f), std::move(x)...);
+}
+
+/*
+ * A value on its way through a composition. Folding | over the functions
+ * applies them one after another: (Piped{x} | h | g).v == g(h(x)).
+ */
+template <class V> struct Piped {
+  V v;
+
+  template <class H>
+  constexpr auto operator|(H &h) && -> Piped<decltype(h(std::declval<V>()))> {
+    return {h(std::forward<V>(v))};
+  }
+};
+
+template <class F, class... G> struct Composition;
+
+/*
+ * Composition<F,G,...,H>(x, y...) == f(g(...h(x)...), y...)
+ *
+ * Only the outermost function receives the extra arguments.
+ */
+template <class F, class G, class... H> struct Composition<F, G, H...> {
+  std::tuple<F, G, H...> fs;
+
+  static constexpr std::size_t inner = 1 + sizeof...(H);
+
+  template <class _F, class _G, class... _H,
+            class = typename std::enable_if<sizeof...(_H) ==
+                                            sizeof...(H)>::type>
+  constexpr Composition(_F &&f, _G &&g, _H &&... h)
+      : fs(std::forward<_F>(f), std::forward<_G>(g), std::forward<_H>(h)...) {
+  }
+
+private:
+  // Pass the innermost result outwards through every function but f.
+  template <class V, std::size_t... I>
+  constexpr auto pipe(Piped<V> &&p, std::index_sequence<I...>)
+      -> decltype((std::move(p) | ... | std::get<inner - 1 - I>(fs)).v) {
+    return (std::move(p) | ... | std::get<inner - 1 - I>(fs)).v;
+  }
+
+  template <class... X>
+  constexpr auto innermost(X &&... x)
+      -> Piped<decltype(std::get<inner>(fs)(std::declval<X>()...))> {
+    return {std::get<inner>(fs)(std::forward<X>(x)...)};
+  }
+
+public:
+  template <class X, class... Y>
+  constexpr auto operator()(X &&x, Y &&... y)
+      -> decltype(std::get<0>(fs)(
+          pipe(innermost(std::declval<X>()),
+               std::make_index_sequence<inner - 1>()),
+          std::declval<Y>()...)) {
+    return std::get<0>(fs)(pipe(innermost(std::forward<X>(x)),
+                                std::make_index_sequence<inner - 1>()),
+                           std::forward<Y>(y)...);
+  }
+
+  // f(g(...h()...)). X is always empty; it only defers the return type.
+  template <class... X,
+            class = typename std::enable_if<sizeof...(X) == 0>::type>
+  constexpr auto operator()(X &&... x)
+      -> decltype(std::get<0>(fs)(
+          pipe(innermost(std::declval<X>()...),
+               std::make_index_sequence<inner - 1>()))) {
+    return std::get<0>(fs)(pipe(innermost(std::forward<X>(x)...),
+                                std::make_index_sequence<inner - 1>()));
+  }
+};
+
+template <class F, class... G>
+constexpr Composition<F, G...> compose(F f, G... g) {
+  return Composition<F, G...>(std::move(f), std::move(g)...);
+}
+
+#endif /* end of include guard: COMPOSITION_H */
@@ -0,0 +1,144 @@
+/*
+ * Compile- and run-time cost of 2, 8 and 32 deep compositions and partial
+ * applications.
+ *
+ * The flat, tuple-backed versions from composition.h are used by default;
+ * -DNESTED switches to the previous recursive definitions kept below.
+ * Compare compile times with
+ *
+ *      time g++ -std=c++17 -O2 composition_bench.cpp
+ *      time g++ -std=c++17 -O2 -DNESTED composition_bench.cpp
+ *
+ * and run-times by running both binaries.
+ */
+
+#include "composition.h"
+#include <chrono>
+#include <iostream>
+#include <utility>
+
+#ifdef NESTED
+
+template <class...> struct NestedPartialApplication;
+
+template <class F, class X> struct NestedPartialApplication<F, X> {
+  F f;
+  X x;
+
+  template <class _F, class _X>
+  constexpr NestedPartialApplication(_F &&f, _X &&x)
+      : f(std::forward<_F>(f)), x(std::forward<_X>(x)) {}
+
+  template <class... Xs>
+  constexpr auto operator()(Xs &&... xs)
+      -> decltype(f(x, std::declval<Xs>()...)) {
+    return f(x, std::forward<Xs>(xs)...);
+  }
+};
+
+template <class F, class X1, class... Xs>
+struct NestedPartialApplication<F, X1, Xs...>
+    : public NestedPartialApplication<NestedPartialApplication<F, X1>, Xs...> {
+  template <class _F, class _X1, class... _Xs>
+  constexpr NestedPartialApplication(_F &&f, _X1 &&x1, _Xs &&... xs)
+      : NestedPartialApplication<NestedPartialApplication<F, X1>, Xs...>(
+            NestedPartialApplication<F, X1>(std::forward<_F>(f),
+                                            std::forward<_X1>(x1)),
+            std::forward<_Xs>(xs)...) {}
+};
+
+template <class F, class... G> struct NestedComposition;
+
+template <class F, class G> struct NestedComposition<F, G> {
+  F f;
+  G g;
+
+  template <class _F, class _G>
+  constexpr NestedComposition(_F &&f, _G &&g)
+      : f(std::forward<_F>(f)), g(std::forward<_G>(g)) {}
+
+  template <class X, class... Y>
+  constexpr decltype(f(g(std::declval<X>()), std::declval<Y>()...))
+  operator()(X &&x, Y &&... y) {
+    return f(g(std::forward<X>(x)), std::forward<Y>(y)...);
+  }
+};
+
+template <class F, class G, class... H>
+struct NestedComposition<F, G, H...>
+    : NestedComposition<F, NestedComposition<G, H...>> {
+  typedef NestedComposition<G, H...> Comp;
+
+  template <class _F, class _G, class... _H>
+  constexpr NestedComposition(_F &&f, _G &&g, _H &&... h)
+      : NestedComposition<_F, NestedComposition<_G, _H...>>(
+            std::forward<_F>(f),
+            Comp(std::forward<_G>(g), std::forward<_H>(h)...)) {}
+};
+
+template <class F, class... G> auto benchCompose(F f, G... g) {
+  return NestedComposition<F, G...>(std::move(f), std::move(g)...);
+}
+
+template <class F, class... X> auto benchCloset(F f, X... x) {
+  return NestedPartialApplication<F, X...>(std::move(f), std::move(x)...);
+}
+
+static const char *const implementation = "nested";
+
+#else
+
+template <class F, class... G> auto benchCompose(F f, G... g) {
+  return compose(std::move(f), std::move(g)...);
+}
+
+template <class F, class... X> auto benchCloset(F f, X... x) {
+  return closet(std::move(f), std::move(x)...);
+}
+
+static const char *const implementation = "flat";
+
+#endif
+
+/* A stage whose effect the optimizer cannot know in advance. */
+template <std::size_t I> struct AddK {
+  unsigned k;
+  unsigned operator()(unsigned x) const { return x * 3 + k + I; }
+};
+
+template <std::size_t... I>
+static auto deepComposition(unsigned k, std::index_sequence<I...>) {
+  return benchCompose(AddK<I>{k}...);
+}
+
+template <std::size_t... I>
+static auto deepPartialApplication(unsigned k, std::index_sequence<I...>) {
+  return benchCloset([](auto... x) { return (x + ...); }, unsigned(k + I)...);
+}
+
+template <std::size_t N> static void run(unsigned k) {
+  const unsigned calls = 10000000;
+  auto composed = deepComposition(k, std::make_index_sequence<N>());
+  auto applied = deepPartialApplication(k, std::make_index_sequence<N - 1>());
+
+  unsigned sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < calls; ++i)
+    sink += composed(i);
+  auto middle = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < calls; ++i)
+    sink += applied(i);
+  auto end = std::chrono::steady_clock::now();
+
+  std::chrono::duration<double, std::nano> c = middle - start, a = end - middle;
+  std::cout << implementation << ", depth " << N << ": compose "
+            << c.count() / calls << " ns/call, partial application "
+            << a.count() / calls << " ns/call (" << sink << ")\n";
+}
+
+int main(int argc, char *argv[]) {
+  run<2>(argc);
+  run<8>(argc);
+  run<32>(argc);
+  return 0;
+}
@@ -6,6 +6,8 @@
 #include <algorithm>
 #include <iterator>
 
+#include "lazy_sequence.h"
+
 struct sequence_tag {};
 struct pointer_tag {};
 
@@ -29,120 +31,7 @@ template< class R, class ... X > struct Category< R(&)(X...) > {
 template< class T >
 using Cat = typename Category< typename std::decay<T>::type >::type;
 
-template<class...> struct PartialApplication;
-
-template< class F, class X >
-struct PartialApplication< F, X >
-{
-    F f;
-    X x;
-
-    template< class _F, class _X >
-    constexpr PartialApplication( _F&& f, _X&& x )
-        : f(std::forward<_F>(f)), x(std::forward<_X>(x))
-    {
-    }
-
-    /* 
-     * The return type of F only gets deduced based on the number of xuments
-     * supplied. PartialApplication otherwise has no idea whether f takes 1 or 10 xs.
-     */
-    template< class ... Xs >
-    constexpr auto operator() ( Xs&& ...xs )
-        -> decltype( f(x,std::declval<Xs>()...) )
-    {
-        return f( x, std::forward<Xs>(xs)... );
-    }
-};
-
-/* Recursive, variadic version. */
-template< class F, class X1, class ...Xs >
-struct PartialApplication< F, X1, Xs... > 
-    : public PartialApplication< PartialApplication<F,X1>, Xs... >
-{
-    template< class _F, class _X1, class ..._Xs >
-    constexpr PartialApplication( _F&& f, _X1&& x1, _Xs&& ...xs )
-        : PartialApplication< PartialApplication<F,X1>, Xs... > (
-            PartialApplication<F,X1>( std::forward<_F>(f), std::forward<_X1>(x1) ),
-            std::forward<_Xs>(xs)...
-        )
-    {
-    }
-};
-
-/* 
- * Some languages implement partial application through closures, which hold
- * references to the function's arguments. But they also often use reference
- * counting. We must consider the scope of the variables we want to apply. If
- * we apply references and then return the applied function, its references
- * will dangle.
- *
- * See: 
- * upward funarg problem http://en.wikipedia.org/wiki/Upward_funarg_problem
- */
-
-/*
- * closure http://en.wikipedia.org/wiki/Closure_%28computer_science%29
- * Here, closure forwards the arguments, which may be references or rvalues--it
- * does not matter. A regular closure works for passing functions down.
- */
-template< class F, class ...X >
-constexpr PartialApplication<F,X...> closure( F&& f, X&& ...x ) {
-    return PartialApplication<F,X...>( std::forward<F>(f), std::forward<X>(x)... );
-}
-
-/*
- * Thinking as closures as open (having references to variables outside of
- * itself), let's refer to a closet as closed. It contains a function and its
- * arguments (or environment).
- */
-template< class F, class ...X >
-constexpr PartialApplication<F,X...> closet( F f, X ...x ) {
-    return PartialApplication<F,X...>( std::move(f), std::move(x)... );
-}
-
-template< class F, class ...G >
-struct Composition;
-
-template< class F, class G >
-struct Composition<F,G>
-{
-    F f; G g;
-
-    template< class _F, class _G >
-    constexpr Composition( _F&& f, _G&& g ) 
-        : f(std::forward<_F>(f)), g(std::forward<_G>(g)) { }
-
-    template< class X, class ...Y >
-    constexpr decltype( f(g(std::declval<X>()), std::declval<Y>()...) )
-    operator() ( X&& x, Y&& ...y ) {
-        return f( g( std::forward<X>(x) ), std::forward<Y>(y)... );
-    }
-
-    constexpr decltype( f(g()) ) operator () () {
-        return f(g());
-    }
-};
-
-template< class F, class G, class ...H >
-struct Composition<F,G,H...> : Composition<F,Composition<G,H...>>
-{
-    typedef Composition<G,H...> Comp;
-
-    template< class _F, class _G, class ..._H >
-    constexpr Composition( _F&& f, _G&& g, _H&& ...h )
-        : Composition<_F,Composition<_G,_H...>> ( 
-            std::forward<_F>(f), 
-            Comp( std::forward<_G>(g), std::forward<_H>(h)... )
-        )
-    {
-    }
-};
-
-template< class F, class ...G >
-constexpr Composition<F,G...> compose( F f, G ...g ) {
-    return Composition<F,G...>( std::move(f), std::move(g)... );
-}
+#include "composition.h"
 
 template< class... > struct Functor;
 
@@ -332,6 +221,7 @@ template< > struct Monad< sequence_tag > {
     static S mfail() { return S{}; }
 };
 
+#include "optional_monad.h"
 
 template< class X > struct Identity {
     using value_type = X;
@@ -476,9 +366,14 @@ template< class _ > struct Monad< IO<_> > {
     }
 };
 
+#include "output_sink.h"
+#include "show.h"
+
 template< class T >
 struct ReadT {
     T operator () () const {
+        // Show any pending prompt before blocking on input.
+        BufferedWriter::local().flush();
         T x;
         std::cin >> x;
         return x;
@@ -491,42 +386,20 @@ constexpr IO<ReadT<T>> readT() {
 }
 
 static void printStr( const std::string& s ) {
-    std::cout << s;
+    BufferedWriter::local().write( s );
 }
 
 static void printCStr( const char* const s ) {
-    std::cout << s;
+    BufferedWriter::local().write( s );
 }
 
 constexpr struct Print {
     template< class X >
     void operator () ( const X& x ) const {
-        std::cout << x;
+        BufferedWriter::local().write( pieceView(shown(x)) );
     }
 } print{};
 
-template< class X >
-static std::string show( const X& x ) {
-    static std::ostringstream oss;
-    oss.str( "" );
-    oss << x;
-    return oss.str();
-}
-
-static std::string show( std::string str ) {
-    return str;
-}
-
-static constexpr const char* show( const char* str ) {
-    return str;
-}
-
-template< class X, class Y, class ...Z >
-static std::string show( const X& x, const Y& y, const Z& ...z ) 
-{
-    return show(x) + show(y,z...);
-}
-
 constexpr struct Echo {
     using F = PartialApplication< Print, std::string >;
     using result_type = IO<F>;
@@ -545,7 +418,26 @@ constexpr struct Echo {
     }
 } echo{};
 
-auto newline = io( []{ std::cout << std::endl; } );
+// Unlike std::endl, this does not flush. Use flush where output must be seen.
+auto newline = io( []{ BufferedWriter::local().put( '\n' ); } );
+
+auto flush = io( []{ BufferedWriter::local().flush(); } );
+
+struct UseSink {
+    OutputSink* sink;
+
+    void operator () () const {
+        BufferedWriter::local().redirect( *sink );
+    }
+};
+
+/* 
+ * Send the output of every following IO action to sink. The sink must stay
+ * alive until output is sent elsewhere.
+ */
+static IO<UseSink> useSink( OutputSink& sink ) {
+    return UseSink{ &sink };
+}
 
 template< class X, class Y, class Z >
 auto equation( const std::string& op, 
@@ -670,6 +562,16 @@ std::unique_ptr<std::pair<float,float>> qroot( float a, float b, float c ) {
     );
 }
 
+// Safe square root, without touching the heap.
+std::optional<float> sqrtO( float x ) {
+    return guard<std::optional>( x >= 0, [x]{ return std::sqrt(x); } );
+}
+
+// Safe fourth root: one >>= and no allocation.
+std::optional<float> root4( float x ) {
+    return sqrtO( x ) >>= sqrtO;
+}
+
 template< class X, class Y >
 std::ostream& operator << ( std::ostream& os, const std::pair<X,Y>& p ) {
     os << '(' << p.first << ',' << p.second << ')';
@@ -718,6 +620,13 @@ int main() {
         >> echo("Unique pairs of Just 5:\n\t")
         >> echo( uniquePairs(p) ) >> newline 
 
+        >> echo( "Lazy sums of [1,2,3] and [3,4]:\n\t" )
+        >> echo( addM2<Lazy<int>>(lazy(v),lazy(w)) ) >> newline
+        >> echo( "First five odd squares:\n\t" )
+        >> echo( take( 5, iota(1) >>= []( int x ) {
+                return guard<Lazy>( x % 2, [x]{ return x*x; } );
+            } ) ) >> newline
+
         >> echo( "Please enter two numbers, x and y: " ) 
         >> (
             addM( readInt, readInt ) >>= []( int x ) { 
@@ -728,7 +637,10 @@ int main() {
         >> echo("The quadratic root of (1,3,-4) = ") 
             >> echo( qroot(1,3,-4) ) >> newline 
         >> echo("The quadratic root of (1,0,4) = ") 
-            >> echo( qroot(1,0,4) ) >> newline;
+            >> echo( qroot(1,0,4) ) >> newline
+        >> echo("The fourth root of 16 = ") >> echo( root4(16) ) >> newline
+        >> echo("The fourth root of -16 = ") >> echo( root4(-16) ) >> newline
+        >> flush;
 
     program();
 
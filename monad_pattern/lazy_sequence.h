@@ -0,0 +1,233 @@
+#ifndef LAZY_SEQUENCE_H
+#define LAZY_SEQUENCE_H
+
+/*
+ * A lazy sequence monad.
+ *
+ * Monad<sequence_tag> materializes a whole container at every step, so
+ *      fmap(f, v) >>= g >>= h
+ * allocates and walks three vectors. A Lazy<X,Source> instead holds a source:
+ * a function object that pushes every element into a yield callback. fmap and
+ * mbind only wrap the source of their argument, so nothing runs until the
+ * sequence gets consumed, and then every element flows through the whole
+ * pipeline in one pass. A yield returning false stops the source early, which
+ * is what makes take() and infinite sequences (iota) work.
+ *
+ * Every stage is its own Source type and calls the yield it is given as a
+ * template, so the compiler sees the whole pipeline and inlines it. Lazy<X>,
+ * with the default source, is the type-erased sequence: any Lazy<X,S>
+ * converts to it, at the price of an indirect call per element. Use it where
+ * sequences of different origin must have one type, as with guard<Lazy> or
+ * addM2.
+ */
+
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+template <class T> struct Category;
+template <class...> struct Functor;
+template <class...> struct Monad;
+
+struct lazy_sequence_tag {};
+
+/* A reference to a yield of X, whatever its type. Does not own it. */
+template <class X> class yield_ref {
+public:
+  template <class Y, class = typename std::enable_if<!std::is_same<
+                         typename std::decay<Y>::type, yield_ref>::value>::type>
+  yield_ref(Y &y)
+      : y_(const_cast<void *>(static_cast<const void *>(&y))),
+        call_([](void *y, const X &x) -> bool {
+          return (*static_cast<Y *>(y))(x);
+        }) {}
+
+  bool operator()(const X &x) const { return call_(y_, x); }
+
+private:
+  void *y_;
+  bool (*call_)(void *, const X &);
+};
+
+template <class X> using any_source = std::function<bool(yield_ref<X>)>;
+
+template <class X, class Source = any_source<X>> class Lazy;
+
+namespace lazy_detail {
+
+template <class S, class Y> bool run(const S &source, Y &y) {
+  return source(y);
+}
+
+/* An empty any_source is the empty sequence. */
+template <class X, class Y> bool run(const any_source<X> &source, Y &y) {
+  return !source || source(yield_ref<X>(y));
+}
+
+template <class X, class S> Lazy<X, S> make(S source) {
+  return Lazy<X, S>(std::move(source));
+}
+
+} // namespace lazy_detail
+
+template <class X, class Source> class Lazy {
+public:
+  using value_type = X;
+  using source_type = Source;
+
+  Lazy() = default;
+
+  explicit Lazy(Source source) : source_(std::move(source)) {}
+
+  /* Erase the source of another sequence of X. */
+  template <class S, class = typename std::enable_if<
+                         std::is_same<Source, any_source<X>>::value &&
+                         !std::is_same<S, Source>::value>::type>
+  Lazy(Lazy<X, S> xs)
+      : source_([xs = std::move(xs)](yield_ref<X> y) { return xs.run(y); }) {}
+
+  /*
+   * Push every element into y. Returns false if y asked to stop before the
+   * source ran out.
+   */
+  template <class Y> bool run(Y &&y) const {
+    return lazy_detail::run(source_, y);
+  }
+
+  template <class F> void for_each(F &&f) const {
+    run([&](const X &x) {
+      f(x);
+      return true;
+    });
+  }
+
+  std::vector<X> to_vector() const {
+    std::vector<X> r;
+    for_each([&](const X &x) { r.push_back(x); });
+    return r;
+  }
+
+private:
+  Source source_{};
+};
+
+template <class X, class S> struct Category<Lazy<X, S>> {
+  using type = lazy_sequence_tag;
+};
+
+/*
+ * Make a sequence lazy. The container is copied or moved into shared
+ * storage, so the result may safely outlive s--like closet, not closure.
+ */
+template <class S, class C = typename std::decay<S>::type,
+          class X = typename C::value_type>
+auto lazy(S &&s) {
+  auto xs = std::make_shared<const C>(std::forward<S>(s));
+  return lazy_detail::make<X>([xs](auto &&y) {
+    for (const X &x : *xs)
+      if (!y(x))
+        return false;
+    return true;
+  });
+}
+
+/* The (possibly infinite) sequence first, first+1, ... up to last. */
+template <class X> auto iota(X first, X last = std::numeric_limits<X>::max()) {
+  return lazy_detail::make<X>([=](auto &&y) {
+    for (X x = first; x < last; ++x)
+      if (!y(x))
+        return false;
+    return true;
+  });
+}
+
+/* The first n elements of xs. Stops the source once they are seen. */
+template <class X, class S> auto take(std::size_t n, Lazy<X, S> xs) {
+  return lazy_detail::make<X>([=](auto &&y) {
+    if (n == 0)
+      return true;
+    std::size_t i = 0;
+    bool more = true;
+    xs.run([&](const X &x) {
+      more = y(x);
+      return more && ++i < n;
+    });
+    return more;
+  });
+}
+
+template <> struct Functor<lazy_sequence_tag> {
+  template <class F, class X, class S,
+            class R = typename std::result_of<F(X)>::type>
+  static auto fmap(F &&f, const Lazy<X, S> &xs) {
+    return lazy_detail::make<R>([xs, f = std::forward<F>(f)](auto &&y) {
+      return xs.run([&](const X &x) { return y(f(x)); });
+    });
+  }
+};
+
+template <> struct Monad<lazy_sequence_tag> {
+
+  template <class S> using mvalue = typename S::value_type;
+
+  template <class F, class X, class S,
+            class R = typename std::result_of<F(X)>::type,
+            class Y = typename R::value_type>
+  static auto mbind(F &&f, const Lazy<X, S> &xs) {
+    return lazy_detail::make<Y>([xs, f = std::forward<F>(f)](auto &&y) {
+      return xs.run([&](const X &x) { return f(x).run(y); });
+    });
+  }
+
+  template <class F, class X, class S, class Y, class T,
+            class R = typename std::result_of<F(X, Y)>::type,
+            class Z = typename R::value_type>
+  static auto mbind(F &&f, const Lazy<X, S> &xs, const Lazy<Y, T> &ys) {
+    return lazy_detail::make<Z>([xs, ys, f = std::forward<F>(f)](auto &&y) {
+      return xs.run([&](const X &x) {
+        return ys.run([&](const Y &z) { return f(x, z).run(y); });
+      });
+    });
+  }
+
+  /*
+   * Unlike Monad<sequence_tag>::mdo, this is the strictly correct definition:
+   * my repeated once for every element of mx. Being lazy, it costs nothing
+   * extra.
+   */
+  template <class X, class S, class Y, class T>
+  static auto mdo(const Lazy<X, S> &mx, const Lazy<Y, T> &my) {
+    return lazy_detail::make<Y>([mx, my](auto &&y) {
+      return mx.run([&](const X &) { return my.run(y); });
+    });
+  }
+
+  template <class S, class X> static S mreturn(X &&x) {
+    using Y = typename S::value_type;
+    return lazy_detail::make<Y>(
+        [x = Y(std::forward<X>(x))](auto &&y) -> bool { return y(x); });
+  }
+
+  template <class S> static S mfail() { return S{}; }
+};
+
+template <class X, class S>
+std::ostream &operator<<(std::ostream &os, const Lazy<X, S> &xs) {
+  os << '[';
+  bool first = true;
+  xs.for_each([&](const X &x) {
+    if (!first)
+      os << ',';
+    os << x;
+    first = false;
+  });
+  os << ']';
+  return os;
+}
+
+#endif /* end of include guard: LAZY_SEQUENCE_H */
@@ -0,0 +1,75 @@
+#ifndef OPTIONAL_MONAD_H
+#define OPTIONAL_MONAD_H
+
+/*
+ * A maybe monad that stores its value in place.
+ *
+ * Functor<pointer_tag>::fmap and Monad<pointer_tag>::mreturn allocate a new
+ * object for every step, so a chain of maybe-style computations over
+ * unique_ptr hits the global allocator once per >>=. std::optional models the
+ * same Just/Nothing semantics without the heap: every step of a chain, no
+ * matter how long, lives on the stack.
+ *
+ * std::optional cannot be compared with nullptr, so it gets its own tag
+ * rather than going through pointer_tag.
+ *
+ * This header expects Category, Functor and Monad to be declared already;
+ * include it after Monad<pointer_tag>.
+ */
+
+#include <optional>
+#include <ostream>
+#include <utility>
+
+struct optional_tag {};
+
+template <class X> struct Category<std::optional<X>> {
+  using type = optional_tag;
+};
+
+template <> struct Functor<optional_tag> {
+  template <class F, class X, class R = typename std::result_of<F(X)>::type>
+  static std::optional<R> fmap(F &&f, const std::optional<X> &o) {
+    return o ? std::optional<R>(std::forward<F>(f)(*o)) : std::nullopt;
+  }
+};
+
+template <> struct Monad<optional_tag> {
+
+  template <class O> using mvalue = typename O::value_type;
+
+  template <class F, class X, class R = typename std::result_of<F(X)>::type>
+  static R mbind(F &&f, const std::optional<X> &o) {
+    return o ? std::forward<F>(f)(*o) : R(std::nullopt);
+  }
+
+  template <class F, class X, class Y,
+            class R = typename std::result_of<F(X, Y)>::type>
+  static R mbind(F &&f, const std::optional<X> &o,
+                 const std::optional<Y> &p) {
+    return o and p ? std::forward<F>(f)(*o, *p) : R(std::nullopt);
+  }
+
+  template <class X, class Y>
+  static std::optional<Y> mdo(const std::optional<X> &mx,
+                              const std::optional<Y> &my) {
+    return mx ? my : std::nullopt;
+  }
+
+  template <class O, class X> static O mreturn(X &&x) {
+    return O(std::in_place, std::forward<X>(x));
+  }
+
+  template <class O> static O mfail() { return std::nullopt; }
+};
+
+template <class X>
+std::ostream &operator<<(std::ostream &os, const std::optional<X> &o) {
+  if (o)
+    os << "Just " << *o;
+  else
+    os << "Nothing";
+  return os;
+}
+
+#endif /* end of include guard: OPTIONAL_MONAD_H */
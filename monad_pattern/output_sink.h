@@ -0,0 +1,188 @@
+#ifndef OUTPUT_SINK_H
+#define OUTPUT_SINK_H
+
+/*
+ * Where IO actions write to.
+ *
+ * Writing every echo straight to std::cout, and flushing every newline with
+ * std::endl, makes a program of many small IO actions syscall-bound. Instead,
+ * each thread owns a BufferedWriter that collects output and hands it to an
+ * OutputSink only when the buffer is full or at an explicit flush point.
+ *
+ * Sinks:
+ *      StreamSink    -- an std::ostream, std::cout by default.
+ *      FdSink        -- a file descriptor, written with write(2).
+ *      MappedLogSink -- a file mapped into memory; a write is a memcpy.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <unistd.h>
+
+class OutputSink {
+public:
+  virtual void write(std::string_view s) = 0;
+  virtual void flush() = 0;
+  virtual ~OutputSink() = default;
+};
+
+class StreamSink : public OutputSink {
+public:
+  explicit StreamSink(std::ostream &os) : os_(os) {}
+
+  void write(std::string_view s) override { os_.write(s.data(), s.size()); }
+
+  void flush() override { os_.flush(); }
+
+private:
+  std::ostream &os_;
+};
+
+class FdSink : public OutputSink {
+public:
+  explicit FdSink(int fd) : fd_(fd) {}
+
+  void write(std::string_view s) override {
+    while (!s.empty()) {
+      ssize_t n = ::write(fd_, s.data(), s.size());
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0)
+        throw std::runtime_error("FdSink: write failed");
+      s.remove_prefix(n);
+    }
+  }
+
+  void flush() override {}
+
+private:
+  int fd_;
+};
+
+/*
+ * Appends to a file of fixed capacity mapped into memory. On destruction the
+ * file is truncated to what was actually written.
+ */
+class MappedLogSink : public OutputSink {
+public:
+  MappedLogSink(const std::string &path, std::size_t capacity)
+      : capacity_(capacity) {
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0)
+      throw std::runtime_error("MappedLogSink: cannot create " + path);
+    if (::ftruncate(fd_, capacity_) != 0) {
+      ::close(fd_);
+      throw std::runtime_error("MappedLogSink: cannot create " + path);
+    }
+    void *p =
+        ::mmap(nullptr, capacity_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (p == MAP_FAILED) {
+      ::close(fd_);
+      throw std::runtime_error("MappedLogSink: cannot map " + path);
+    }
+    data_ = static_cast<char *>(p);
+  }
+
+  MappedLogSink(const MappedLogSink &) = delete;
+  MappedLogSink &operator=(const MappedLogSink &) = delete;
+
+  ~MappedLogSink() override {
+    ::munmap(data_, capacity_);
+    if (::ftruncate(fd_, size_) != 0) {
+      // Nothing sensible to do in a destructor; the tail stays zeroed.
+    }
+    ::close(fd_);
+  }
+
+  void write(std::string_view s) override {
+    if (size_ + s.size() > capacity_)
+      throw std::runtime_error("MappedLogSink: log is full");
+    std::memcpy(data_ + size_, s.data(), s.size());
+    size_ += s.size();
+  }
+
+  void flush() override { ::msync(data_, size_, MS_ASYNC); }
+
+private:
+  int fd_ = -1;
+  char *data_ = nullptr;
+  std::size_t size_ = 0;
+  std::size_t capacity_;
+};
+
+/*
+ * A per-thread output buffer in front of a sink.
+ */
+class BufferedWriter {
+public:
+  static constexpr std::size_t capacity = 64 * 1024;
+
+  BufferedWriter() : sink_(&defaultSink()) {}
+
+  BufferedWriter(const BufferedWriter &) = delete;
+  BufferedWriter &operator=(const BufferedWriter &) = delete;
+
+  ~BufferedWriter() { flush(); }
+
+  /* The writer of the calling thread. */
+  static BufferedWriter &local() {
+    thread_local BufferedWriter writer;
+    return writer;
+  }
+
+  static OutputSink &defaultSink() {
+    static StreamSink sink(std::cout);
+    return sink;
+  }
+
+  /* Send everything written so far to sink and write to s from now on. */
+  void redirect(OutputSink &s) {
+    flush();
+    sink_ = &s;
+  }
+
+  void write(std::string_view s) {
+    if (size_ + s.size() > capacity) {
+      drain();
+      if (s.size() > capacity) {
+        sink_->write(s);
+        return;
+      }
+    }
+    std::memcpy(buf_ + size_, s.data(), s.size());
+    size_ += s.size();
+  }
+
+  void put(char c) {
+    if (size_ == capacity)
+      drain();
+    buf_[size_++] = c;
+  }
+
+  void flush() {
+    drain();
+    sink_->flush();
+  }
+
+private:
+  void drain() {
+    if (size_) {
+      sink_->write(std::string_view(buf_, size_));
+      size_ = 0;
+    }
+  }
+
+  OutputSink *sink_;
+  std::size_t size_ = 0;
+  char buf_[capacity];
+};
+
+#endif /* end of include guard: OUTPUT_SINK_H */
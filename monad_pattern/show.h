@@ -0,0 +1,115 @@
+#ifndef SHOW_H
+#define SHOW_H
+
+/*
+ * show(x, y, z...) converts its arguments to one std::string.
+ *
+ * Every argument is first turned into a piece: numbers are formatted with
+ * std::to_chars into a small buffer on the stack, strings are only viewed.
+ * Knowing the size of every piece, the result is reserved once and filled
+ * in a single pass--no temporary strings, no repeated concatenation.
+ *
+ * Anything else still goes through operator<<, but into a thread_local
+ * stream, so show may be called from many threads at once.
+ */
+
+#include <charconv>
+#include <cstddef>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+/* A number formatted on the stack. */
+struct ShownNumber {
+  char buf[32];
+  std::size_t size = 0;
+};
+
+/*
+ * Numbers that to_chars formats exactly like operator<< does. Character
+ * types are excluded as streams print them as characters.
+ */
+template <class X>
+using IsShownNumber = std::integral_constant<
+    bool, std::is_arithmetic<X>::value && !std::is_same<X, bool>::value &&
+              !std::is_same<X, char>::value &&
+              !std::is_same<X, signed char>::value &&
+              !std::is_same<X, unsigned char>::value &&
+              !std::is_same<X, wchar_t>::value &&
+              !std::is_same<X, char16_t>::value &&
+              !std::is_same<X, char32_t>::value>;
+
+template <class X>
+auto shown(const X &x) ->
+    typename std::enable_if<std::is_integral<X>::value &&
+                                IsShownNumber<X>::value,
+                            ShownNumber>::type {
+  ShownNumber n;
+  n.size = std::to_chars(n.buf, n.buf + sizeof(n.buf), x).ptr - n.buf;
+  return n;
+}
+
+template <class X>
+auto shown(const X &x) ->
+    typename std::enable_if<std::is_floating_point<X>::value, ShownNumber>::type {
+  // Same as an ostream with default flags: %g with a precision of 6.
+  ShownNumber n;
+  n.size = std::to_chars(n.buf, n.buf + sizeof(n.buf), x,
+                         std::chars_format::general, 6)
+               .ptr -
+           n.buf;
+  return n;
+}
+
+inline ShownNumber shown(char c) {
+  ShownNumber n;
+  n.buf[0] = c;
+  n.size = 1;
+  return n;
+}
+
+inline std::string_view shown(bool b) { return b ? "1" : "0"; }
+
+inline std::string_view shown(const char *str) { return str; }
+
+inline std::string_view shown(std::string_view str) { return str; }
+
+template <class X>
+auto shown(const X &x) ->
+    typename std::enable_if<!IsShownNumber<X>::value &&
+                                !std::is_same<X, bool>::value &&
+                                !std::is_same<X, char>::value &&
+                                !std::is_convertible<X, std::string_view>::value,
+                            std::string>::type {
+  thread_local std::ostringstream oss;
+  oss.str("");
+  oss << x;
+  return oss.str();
+}
+
+inline std::string_view pieceView(const ShownNumber &n) {
+  return {n.buf, n.size};
+}
+
+inline std::string_view pieceView(std::string_view str) { return str; }
+
+inline std::string show(std::string str) { return str; }
+
+constexpr const char *show(const char *str) { return str; }
+
+template <class X, class... Y>
+std::string show(const X &x, const Y &... y) {
+  const auto pieces = std::make_tuple(shown(x), shown(y)...);
+  return std::apply(
+      [](const auto &... p) {
+        std::string r;
+        r.reserve((pieceView(p).size() + ...));
+        (r.append(pieceView(p)), ...);
+        return r;
+      },
+      pieces);
+}
+
+#endif /* end of include guard: SHOW_H */
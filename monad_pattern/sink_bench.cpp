@@ -0,0 +1,72 @@
+#include "output_sink.h"
+#include "show.h"
+#include <chrono>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+/*
+ * Lines per second written by echo(...) >> newline style output, for the old
+ * std::endl path and for every sink behind a BufferedWriter.
+ */
+
+static const int lines = 2000000;
+
+template <class F> static double linesPerSec(F &&writeLine) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < lines; ++i) {
+    writeLine(i);
+  }
+  std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+  return lines / d.count();
+}
+
+static double buffered(OutputSink &sink) {
+  BufferedWriter &out = BufferedWriter::local();
+  out.redirect(sink);
+  double r = linesPerSec([&](int i) {
+    out.write(show("line ", i, ": x = ", i * 0.5));
+    out.put('\n');
+  });
+  out.flush();
+  out.redirect(BufferedWriter::defaultSink());
+  return r;
+}
+
+int main(int argc, char *argv[]) {
+  const std::string dir = argc > 1 ? argv[1] : "/tmp";
+
+  std::ofstream endlFile(dir + "/sink_bench_endl.log");
+  double endl = linesPerSec([&](int i) {
+    endlFile << show("line ", i, ": x = ", i * 0.5) << std::endl;
+  });
+
+  std::ofstream streamFile(dir + "/sink_bench_stream.log");
+  StreamSink stream(streamFile);
+  double streamed = buffered(stream);
+
+  int fd = ::open((dir + "/sink_bench_fd.log").c_str(),
+                  O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    std::cerr << "cannot create " << dir << "/sink_bench_fd.log\n";
+    return 1;
+  }
+  FdSink fdSink(fd);
+  double direct = buffered(fdSink);
+  ::close(fd);
+
+  double mapped;
+  {
+    MappedLogSink log(dir + "/sink_bench_mapped.log", 256 * 1024 * 1024);
+    mapped = buffered(log);
+  }
+
+  std::cout << "std::endl:              " << endl << " lines/s\n"
+            << "buffered StreamSink:    " << streamed << " lines/s\n"
+            << "buffered FdSink:        " << direct << " lines/s\n"
+            << "buffered MappedLogSink: " << mapped << " lines/s\n";
+
+  return 0;
+}
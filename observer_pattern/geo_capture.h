@@ -0,0 +1,295 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef GEO_CAPTURE_H
+#define GEO_CAPTURE_H
+
+#include "geo_codec.h"
+#include "signal.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * A capture is a magic number followed by one record per emission:
+ *      | time | points | type | reserved | x y x y ... |
+ * where time is in nanoseconds since the recorder started. Reading stops at
+ * a record that does not fit the file, so a capture cut short by a crash
+ * replays up to its last complete record.
+ */
+namespace geo_capture {
+
+struct record_header {
+  std::uint64_t time_ns;
+  std::uint32_t points;
+  std::uint16_t type;
+  std::uint16_t reserved;
+};
+
+static constexpr char magic[8] = {'G', 'E', 'O', 'C', 'A', 'P', 'T', '1'};
+
+} // namespace geo_capture
+
+/**
+ * Records emissions of geo data into a capture file. Call it like a slot, or
+ * let it tap a signal. Records are buffered and written in large chunks.
+ */
+class geo_recorder {
+public:
+  using clock = std::chrono::steady_clock;
+
+  explicit geo_recorder(const std::string &path,
+                        std::size_t buffer_size = 1 << 20)
+      : start_(clock::now()), buffer_size_(buffer_size) {
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0)
+      throw std::runtime_error("geo_recorder: cannot create " + path);
+    buffer_.reserve(buffer_size);
+    append(geo_capture::magic, sizeof(geo_capture::magic));
+  }
+
+  geo_recorder(const geo_recorder &) = delete;
+  geo_recorder &operator=(const geo_recorder &) = delete;
+
+  /**
+   * Errors of the last write are lost here; call close() to see them.
+   */
+  ~geo_recorder() {
+    if (fd_ >= 0) {
+      try {
+        close();
+      } catch (const std::runtime_error &) {
+        // Nothing sensible to do in a destructor.
+      }
+    }
+  }
+
+  /**
+   * Record one emission, timestamped now.
+   */
+  template <typename GeoData> void operator()(const GeoData &data) {
+    using codec = geo_codec<GeoData>;
+    const std::size_t points = codec::points(data);
+    const std::size_t size =
+        sizeof(geo_capture::record_header) + points * 2 * sizeof(double);
+    if (buffer_.size() + size > buffer_size_)
+      flush();
+    const std::size_t offset = buffer_.size();
+    buffer_.resize(offset + size);
+    geo_capture::record_header h{elapsed(), static_cast<std::uint32_t>(points),
+                                 codec::type, 0};
+    std::memcpy(&buffer_[offset], &h, sizeof(h));
+    // Aligned, as the magic number and records are multiples of 8 bytes.
+    codec::write(data,
+                 reinterpret_cast<double *>(&buffer_[offset + sizeof(h)]));
+    if (buffer_.size() > buffer_size_)
+      flush(); // a record larger than the buffer
+    ++records_;
+  }
+
+  /**
+   * Record everything the signal emits from now on. Returns the connection,
+   * to disconnect from the signal.
+   */
+  template <typename GeoData> int tap(const signal<GeoData> &s) {
+    return s.connect(
+        [this](const std::decay_t<GeoData> &data) { (*this)(data); });
+  }
+
+  /**
+   * Write buffered records to the file.
+   */
+  void flush() {
+    std::size_t written = 0;
+    while (written < buffer_.size()) {
+      const ssize_t w =
+          ::write(fd_, buffer_.data() + written, buffer_.size() - written);
+      if (w < 0 && errno == EINTR)
+        continue;
+      if (w <= 0) {
+        // Keep what is left, so a later flush does not write it twice.
+        buffer_.erase(buffer_.begin(), buffer_.begin() + written);
+        throw std::runtime_error("geo_recorder: write failed");
+      }
+      written += w;
+    }
+    buffer_.clear();
+  }
+
+  /**
+   * Write buffered records and close the file, reporting any failure.
+   * Recording stops here.
+   */
+  void close() {
+    const int fd = fd_;
+    try {
+      flush();
+    } catch (...) {
+      fd_ = -1;
+      ::close(fd);
+      throw;
+    }
+    fd_ = -1;
+    if (::close(fd) != 0)
+      throw std::runtime_error("geo_recorder: close failed");
+  }
+
+  std::size_t records() const { return records_; }
+
+private:
+  std::uint64_t elapsed() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() -
+                                                                start_)
+        .count();
+  }
+
+  void append(const void *p, std::size_t n) {
+    const char *b = static_cast<const char *>(p);
+    buffer_.insert(buffer_.end(), b, b + n);
+  }
+
+  int fd_ = -1;
+  clock::time_point start_;
+  std::size_t buffer_size_;
+  std::vector<char> buffer_;
+  std::size_t records_ = 0;
+};
+
+/**
+ * Memory-maps a capture and emits its records again.
+ */
+class geo_replayer {
+public:
+  using clock = std::chrono::steady_clock;
+
+  /**
+   * Replay speed: 1 reproduces the recorded timing, 2 is twice as fast, and
+   * as_fast_as_possible does not wait at all.
+   */
+  static constexpr double as_fast_as_possible = 0;
+
+  explicit geo_replayer(const std::string &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error("geo_replayer: cannot open " + path);
+    struct stat st;
+    ::fstat(fd, &st);
+    size_ = st.st_size;
+    if (size_ < sizeof(geo_capture::magic)) {
+      ::close(fd);
+      throw std::runtime_error("geo_replayer: not a capture: " + path);
+    }
+    void *p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+      throw std::runtime_error("geo_replayer: cannot map " + path);
+    data_ = static_cast<const char *>(p);
+    ::madvise(p, size_, MADV_SEQUENTIAL);
+    if (std::memcmp(data_, geo_capture::magic, sizeof(geo_capture::magic)) !=
+        0) {
+      ::munmap(p, size_);
+      throw std::runtime_error("geo_replayer: not a capture: " + path);
+    }
+  }
+
+  geo_replayer(const geo_replayer &) = delete;
+  geo_replayer &operator=(const geo_replayer &) = delete;
+
+  ~geo_replayer() { ::munmap(const_cast<char *>(data_), size_); }
+
+  /**
+   * Call f(const geo_view &, time_ns) for every record, in place, at the
+   * given speed. Returns how many records were replayed.
+   */
+  template <typename F>
+  std::size_t replay_views(F &&f, double speed = as_fast_as_possible) const {
+    const clock::time_point start = clock::now();
+    std::size_t replayed = 0;
+    std::size_t offset = sizeof(geo_capture::magic);
+    while (offset + sizeof(geo_capture::record_header) <= size_) {
+      geo_capture::record_header h;
+      std::memcpy(&h, data_ + offset, sizeof(h));
+      const std::size_t size = sizeof(h) + h.points * 2 * sizeof(double);
+      if (offset + size > size_)
+        break;
+      if (speed > 0) {
+        wait_until(start + std::chrono::nanoseconds(
+                               static_cast<std::int64_t>(h.time_ns / speed)));
+      }
+      f(geo_view{h.type,
+                 reinterpret_cast<const double *>(data_ + offset + sizeof(h)),
+                 h.points},
+        h.time_ns);
+      ++replayed;
+      offset += size;
+    }
+    return replayed;
+  }
+
+  /**
+   * Decode every record and call f with it, for the types of geo data f
+   * accepts; records of other types are skipped. The decoded objects are
+   * reused from record to record.
+   */
+  template <typename F>
+  std::size_t replay(F &&f, double speed = as_fast_as_possible) const {
+    point p;
+    line l;
+    ring r;
+    std::size_t emitted = 0;
+    replay_views(
+        [&](const geo_view &view, std::uint64_t) {
+          emitted += emit(f, view, p) || emit(f, view, l) || emit(f, view, r);
+        },
+        speed);
+    return emitted;
+  }
+
+  /**
+   * Replay into a signal of one type of geo data.
+   */
+  template <typename GeoData>
+  std::size_t replay(signal<GeoData> &s,
+                     double speed = as_fast_as_possible) const {
+    return replay([&s](const std::decay_t<GeoData> &data) { s(data); },
+                  speed);
+  }
+
+private:
+  // Sleeping overshoots by up to several hundred microseconds, so the last
+  // stretch is spent yielding instead.
+  static void wait_until(clock::time_point due) {
+    std::this_thread::sleep_until(due - std::chrono::microseconds(500));
+    while (clock::now() < due)
+      std::this_thread::yield();
+  }
+
+  template <typename F, typename GeoData>
+  static bool emit(F &f, const geo_view &view, GeoData &scratch) {
+    if constexpr (std::is_invocable_v<F &, const GeoData &>) {
+      if (view.type != geo_codec<GeoData>::type)
+        return false;
+      geo_codec<GeoData>::read(view.xy, view.points, scratch);
+      f(static_cast<const GeoData &>(scratch));
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+  const char *data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+#endif /* end of include guard: GEO_CAPTURE_H */
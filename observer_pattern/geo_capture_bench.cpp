@@ -0,0 +1,122 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "geo_capture.h"
+#include "geo_data_generator.h"
+#include "geometry.h"
+#include "signal.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+/**
+ * Recording and replay rates of a capture of one million lines and rings of
+ * 4 to 64 points, and how closely a replay at recorded speed follows the
+ * recorded timing. Pass the directory for the capture as argument.
+ */
+using clock_type = std::chrono::steady_clock;
+
+template <typename Points> static Points create_shape(std::size_t n) {
+  Points shape;
+  for (std::size_t i = 0; i < n; ++i)
+    shape.push_back(create_point());
+  return shape;
+}
+
+int main(int argc, char *argv[]) {
+  const std::string path =
+      std::string(argc > 1 ? argv[1] : ".") + "/geo_capture_bench.capture";
+  const int emits = 1000000;
+
+  std::vector<line> paths;
+  std::vector<ring> fields;
+  for (std::size_t n = 4; n <= 64; ++n) {
+    paths.push_back(create_shape<line>(n));
+    fields.push_back(create_shape<ring>(n));
+  }
+
+  signal<const line &> line_signal;
+  signal<const ring &> ring_signal;
+  std::size_t bytes = 0;
+  {
+    geo_recorder recorder(path);
+    recorder.tap(line_signal);
+    recorder.tap(ring_signal);
+    const auto start = clock_type::now();
+    for (int i = 0; i < emits; ++i) {
+      if (i % 4 == 0)
+        line_signal(paths[i % paths.size()]);
+      else
+        ring_signal(fields[i % fields.size()]);
+    }
+    recorder.close();
+    std::chrono::duration<double> d = clock_type::now() - start;
+    std::cout << "record: " << emits / d.count() << " emits/s\n";
+  }
+
+  {
+    geo_replayer capture(path);
+    const auto start = clock_type::now();
+    capture.replay_views([&](const geo_view &v, std::uint64_t) {
+      bytes += sizeof(geo_capture::record_header) + v.points * 16;
+    });
+    const auto middle = clock_type::now();
+    std::size_t lines = 0, rings = 0, points = 0;
+    line_signal.disconnect_all();
+    ring_signal.disconnect_all();
+    line_signal.connect([&](const line &l) {
+      ++lines;
+      points += l.size();
+    });
+    ring_signal.connect([&](const ring &r) {
+      ++rings;
+      points += r.size();
+    });
+    capture.replay([&](const auto &data) {
+      if constexpr (std::is_same_v<std::decay_t<decltype(data)>, line>)
+        line_signal(data);
+      else if constexpr (std::is_same_v<std::decay_t<decltype(data)>, ring>)
+        ring_signal(data);
+    });
+    std::chrono::duration<double> views = middle - start,
+                                  decoded = clock_type::now() - middle;
+    std::cout << "replay in place: " << bytes / views.count() / 1e6
+              << " MB/s\n";
+    std::cout << "replay into signals: " << emits / decoded.count()
+              << " emits/s (" << lines << " lines, " << rings << " rings, "
+              << points << " points)\n";
+  }
+
+  // A session of 2000 emits at 1 kHz, replayed at recorded speed.
+  {
+    geo_recorder recorder(path);
+    const auto start = clock_type::now();
+    for (int i = 0; i < 2000; ++i) {
+      std::this_thread::sleep_until(start + std::chrono::milliseconds(i / 2));
+      recorder(fields[i % fields.size()]);
+    }
+    recorder.close();
+  }
+  {
+    geo_replayer capture(path);
+    double late = 0;
+    std::uint64_t last = 0;
+    const auto start = clock_type::now();
+    capture.replay_views(
+        [&](const geo_view &, std::uint64_t time_ns) {
+          std::chrono::duration<double, std::micro> d =
+              clock_type::now() - start;
+          late += d.count() - time_ns / 1e3;
+          last = time_ns;
+        },
+        1);
+    std::chrono::duration<double> d = clock_type::now() - start;
+    std::cout << "paced replay: " << d.count() << " s for " << last / 1e9
+              << " s recorded, " << late / 2000 << " us late on average\n";
+  }
+  ::unlink(path.c_str());
+  return 0;
+}
@@ -0,0 +1,66 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef GEO_CODEC_H
+#define GEO_CODEC_H
+
+#include "geometry.h"
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Encoding of geo data as records of a shared memory ring or a capture: a
+ * type tag and the coordinates as consecutive x, y doubles.
+ */
+template <typename GeoData> struct geo_codec;
+
+template <> struct geo_codec<point> {
+  static constexpr std::uint16_t type = 1;
+  static std::size_t points(const point &) { return 1; }
+  static void write(const point &p, double *xy) {
+    xy[0] = p.get<0>();
+    xy[1] = p.get<1>();
+  }
+  static void read(const double *xy, std::size_t, point &p) {
+    p.set<0>(xy[0]);
+    p.set<1>(xy[1]);
+  }
+};
+
+template <typename Points> struct geo_codec_points {
+  static std::size_t points(const Points &ps) { return ps.size(); }
+  static void write(const Points &ps, double *xy) {
+    for (const point &p : ps) {
+      *xy++ = p.get<0>();
+      *xy++ = p.get<1>();
+    }
+  }
+  static void read(const double *xy, std::size_t n, Points &ps) {
+    // Reuses the capacity of ps, so steady state does not allocate.
+    ps.resize(n);
+    for (point &p : ps) {
+      p.set<0>(*xy++);
+      p.set<1>(*xy++);
+    }
+  }
+};
+
+template <> struct geo_codec<line> : geo_codec_points<line> {
+  static constexpr std::uint16_t type = 2;
+};
+
+template <> struct geo_codec<ring> : geo_codec_points<ring> {
+  static constexpr std::uint16_t type = 3;
+};
+
+/**
+ * A record as it lies in memory, for readers that use it in place.
+ */
+struct geo_view {
+  std::uint16_t type;
+  const double *xy;
+  std::size_t points;
+};
+
+#endif /* end of include guard: GEO_CODEC_H */
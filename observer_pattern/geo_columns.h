@@ -0,0 +1,710 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef GEO_COLUMNS_H
+#define GEO_COLUMNS_H
+
+#include "geo_codec.h"
+#include "geometry.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * A file of lines or rings, stored as columns.
+ *
+ * Coordinates are quantized: a coordinate v is stored as the integer
+ * round((v - origin) * scale), so a scale of 100 keeps centimeters of a
+ * local frame in meters. The points of all shapes follow each other, cut
+ * into blocks of block_points points. Within a block, x and y are two
+ * columns of deltas from the previous point, each as narrow as the largest
+ * delta of the block allows (1, 2 or 4 bytes).
+ *
+ * On disk:
+ *      | header | blocks' columns ... | shapes | block directory |
+ * A shape is the index of its first point and the first and last point
+ * themselves, so a view starts decoding right at its shape. The block
+ * directory has the first and last point, the bounding box and the column
+ * widths of every block.
+ */
+namespace geo_columns {
+
+struct file_header {
+  char magic[8];
+  std::uint16_t type; // geo_codec<GeoData>::type
+  std::uint16_t reserved;
+  std::uint32_t block_points;
+  std::uint64_t shapes;
+  std::uint64_t points;
+  std::uint64_t blocks;
+  double origin[2];
+  double scale;
+  std::uint64_t shapes_at;
+  std::uint64_t blocks_at;
+};
+
+struct shape {
+  std::uint64_t first;
+  std::int32_t first_xy[2];
+  std::int32_t last_xy[2];
+};
+
+struct block {
+  std::int32_t first[2];
+  std::int32_t last[2];
+  std::int32_t min[2];
+  std::int32_t max[2];
+  std::uint64_t columns_at;
+  std::uint32_t points;
+  std::uint8_t width[2];
+  std::uint16_t reserved;
+};
+
+static constexpr char magic[8] = {'G', 'E', 'O', 'C', 'O', 'L', 'S', '1'};
+
+inline std::size_t padded(std::size_t n) { return (n + 7) & ~std::size_t(7); }
+
+} // namespace geo_columns
+
+class geo_column_store;
+
+/**
+ * Walks the points of one shape, decoding deltas straight from the mapped
+ * file. Points are returned by value.
+ *
+ * Boost.Geometry requires random access iterators for linestrings and
+ * rings, so this is one, but a jump by n decodes the n deltas in between.
+ * The algorithms walk point by point anyway.
+ */
+class geo_column_iterator {
+public:
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = point;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const point *;
+  using reference = point;
+
+  geo_column_iterator() = default;
+
+  inline geo_column_iterator(const geo_column_store *store,
+                             std::uint64_t index, std::uint64_t end,
+                             const std::int32_t *xy);
+
+  inline point operator*() const;
+
+  geo_column_iterator &operator++() {
+    // The end position keeps the last point, so -- can come back from it.
+    if (++index_ == end_)
+      return *this;
+    const std::uint64_t i = index_ & block_mask_;
+    if (i == 0) {
+      enter(index_ >> block_shift_);
+      const geo_columns::block &b = blocks_[index_ >> block_shift_];
+      x_ = b.first[0];
+      y_ = b.first[1];
+    } else {
+      x_ += delta(dx_, width_[0], i);
+      y_ += delta(dy_, width_[1], i);
+    }
+    return *this;
+  }
+
+  geo_column_iterator &operator--() {
+    if (index_-- == end_)
+      return *this;
+    const std::uint64_t i = (index_ + 1) & block_mask_;
+    if (i == 0) {
+      enter(index_ >> block_shift_);
+      const geo_columns::block &b = blocks_[index_ >> block_shift_];
+      x_ = b.last[0];
+      y_ = b.last[1];
+    } else {
+      x_ -= delta(dx_, width_[0], i);
+      y_ -= delta(dy_, width_[1], i);
+    }
+    return *this;
+  }
+
+  geo_column_iterator operator++(int) {
+    geo_column_iterator old = *this;
+    ++*this;
+    return old;
+  }
+
+  geo_column_iterator operator--(int) {
+    geo_column_iterator old = *this;
+    --*this;
+    return old;
+  }
+
+  geo_column_iterator &operator+=(difference_type n) {
+    for (; n > 0; --n)
+      ++*this;
+    for (; n < 0; ++n)
+      --*this;
+    return *this;
+  }
+
+  geo_column_iterator &operator-=(difference_type n) { return *this += -n; }
+
+  geo_column_iterator operator+(difference_type n) const {
+    geo_column_iterator it = *this;
+    return it += n;
+  }
+
+  friend geo_column_iterator operator+(difference_type n,
+                                       const geo_column_iterator &it) {
+    return it + n;
+  }
+
+  geo_column_iterator operator-(difference_type n) const {
+    geo_column_iterator it = *this;
+    return it -= n;
+  }
+
+  difference_type operator-(const geo_column_iterator &other) const {
+    return static_cast<difference_type>(index_ - other.index_);
+  }
+
+  point operator[](difference_type n) const { return *(*this + n); }
+
+  bool operator==(const geo_column_iterator &other) const {
+    return index_ == other.index_;
+  }
+
+  bool operator!=(const geo_column_iterator &other) const {
+    return index_ != other.index_;
+  }
+
+  bool operator<(const geo_column_iterator &other) const {
+    return index_ < other.index_;
+  }
+
+  bool operator>(const geo_column_iterator &other) const {
+    return index_ > other.index_;
+  }
+
+  bool operator<=(const geo_column_iterator &other) const {
+    return index_ <= other.index_;
+  }
+
+  bool operator>=(const geo_column_iterator &other) const {
+    return index_ >= other.index_;
+  }
+
+private:
+  static std::int32_t delta(const char *column, unsigned width,
+                            std::uint64_t i) {
+    switch (width) {
+    case 1:
+      return static_cast<std::int8_t>(column[i]);
+    case 2: {
+      std::int16_t d;
+      std::memcpy(&d, column + 2 * i, sizeof(d));
+      return d;
+    }
+    default: {
+      std::int32_t d;
+      std::memcpy(&d, column + 4 * i, sizeof(d));
+      return d;
+    }
+    }
+  }
+
+  inline void enter(std::uint64_t block);
+
+  const geo_column_store *store_ = nullptr;
+  const geo_columns::block *blocks_ = nullptr;
+  const char *dx_ = nullptr;
+  const char *dy_ = nullptr;
+  std::uint64_t index_ = 0;
+  std::uint64_t end_ = 0;
+  std::uint64_t block_mask_ = 0;
+  unsigned block_shift_ = 0;
+  std::uint8_t width_[2] = {0, 0};
+  // Quantized, with wrap-around, so that -- exactly undoes ++.
+  std::uint32_t x_ = 0;
+  std::uint32_t y_ = 0;
+};
+
+/**
+ * One shape of the file, in place. Registered with Boost.Geometry as a
+ * linestring or ring, depending on GeoData.
+ */
+template <typename GeoData> class geo_column_view {
+public:
+  using iterator = geo_column_iterator;
+  using const_iterator = geo_column_iterator;
+  using value_type = point;
+  using size_type = std::size_t;
+
+  geo_column_view(const geo_column_store *store, const geo_columns::shape &s,
+                  std::uint64_t end)
+      : store_(store), shape_(&s), end_(end) {}
+
+  iterator begin() const {
+    return iterator(store_, shape_->first, end_, shape_->first_xy);
+  }
+
+  iterator end() const {
+    if (end_ == shape_->first)
+      return begin();
+    iterator last(store_, end_ - 1, end_, shape_->last_xy);
+    return ++last;
+  }
+
+  std::size_t size() const { return end_ - shape_->first; }
+  bool empty() const { return size() == 0; }
+
+  /**
+   * A copy in the double model.
+   */
+  GeoData decode() const { return GeoData(begin(), end()); }
+
+private:
+  const geo_column_store *store_;
+  const geo_columns::shape *shape_;
+  std::uint64_t end_;
+};
+
+/**
+ * A memory-mapped column file. Opening it reads the header, the shapes and
+ * the block directory, to check that they stay inside the file; the pages of
+ * a block's columns are read once a view walks through it.
+ */
+class geo_column_store {
+public:
+  explicit geo_column_store(const std::string &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error("geo_column_store: cannot open " + path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0 ||
+        std::size_t(st.st_size) < sizeof(geo_columns::file_header)) {
+      ::close(fd);
+      throw std::runtime_error("geo_column_store: not a column file: " + path);
+    }
+    size_ = st.st_size;
+    void *p = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+      throw std::runtime_error("geo_column_store: cannot map " + path);
+    data_ = static_cast<const char *>(p);
+    header_ = reinterpret_cast<const geo_columns::file_header *>(data_);
+    if (!valid()) {
+      ::munmap(p, size_);
+      throw std::runtime_error("geo_column_store: not a column file: " + path);
+    }
+    inverse_scale_ = 1 / header_->scale;
+  }
+
+  geo_column_store(const geo_column_store &) = delete;
+  geo_column_store &operator=(const geo_column_store &) = delete;
+
+  ~geo_column_store() { ::munmap(const_cast<char *>(data_), size_); }
+
+  std::uint16_t type() const { return header_->type; }
+  std::size_t size() const { return header_->shapes; }
+  std::size_t points() const { return header_->points; }
+  std::size_t blocks() const { return header_->blocks; }
+  std::size_t bytes() const { return size_; }
+
+  const geo_columns::block &block(std::size_t i) const { return blocks_[i]; }
+
+  point dequantize(std::int32_t x, std::int32_t y) const {
+    return point{header_->origin[0] + x * inverse_scale_,
+                 header_->origin[1] + y * inverse_scale_};
+  }
+
+  std::int32_t quantize(double v, int axis) const {
+    const double q = std::round((v - header_->origin[axis]) * header_->scale);
+    return static_cast<std::int32_t>(
+        std::clamp<double>(q, INT32_MIN, INT32_MAX));
+  }
+
+protected:
+  const geo_columns::shape &shape(std::size_t i) const { return shapes_[i]; }
+
+  std::uint64_t shape_end(std::size_t i) const {
+    return i + 1 < header_->shapes ? shapes_[i + 1].first : header_->points;
+  }
+
+  // The shapes with points in block i.
+  std::pair<std::size_t, std::size_t> shapes_of(std::size_t i) const {
+    const std::uint64_t first = std::uint64_t(i) << block_shift_;
+    const std::uint64_t last = first + blocks_[i].points;
+    auto by_first = [](const geo_columns::shape &s, std::uint64_t point) {
+      return s.first < point;
+    };
+    const geo_columns::shape *end = shapes_ + header_->shapes;
+    // The last shape starting at or before the block's first point.
+    const geo_columns::shape *from =
+        std::lower_bound(shapes_, end, first + 1, by_first);
+    if (from != shapes_)
+      --from;
+    const geo_columns::shape *to = std::lower_bound(from, end, last, by_first);
+    return {std::size_t(from - shapes_), std::size_t(to - shapes_)};
+  }
+
+private:
+  friend class geo_column_iterator;
+
+  /**
+   * Whether count items of the given size at offset at are inside the file
+   * and aligned for them.
+   */
+  bool inside(std::uint64_t at, std::uint64_t count, std::size_t size) const {
+    return at <= size_ && at % alignof(std::uint64_t) == 0 &&
+           count <= (size_ - at) / size;
+  }
+
+  /**
+   * Check the header, the shapes and the block directory against each other
+   * and the file size, so that views never read outside the mapping.
+   */
+  bool valid() {
+    const geo_columns::file_header &h = *header_;
+    if (std::memcmp(h.magic, geo_columns::magic, sizeof(geo_columns::magic)) !=
+            0 ||
+        h.block_points == 0 || (h.block_points & (h.block_points - 1)) != 0 ||
+        !inside(h.shapes_at, h.shapes, sizeof(geo_columns::shape)) ||
+        !inside(h.blocks_at, h.blocks, sizeof(geo_columns::block)) ||
+        !(h.scale > 0) || !std::isfinite(h.scale))
+      return false;
+    shapes_ = reinterpret_cast<const geo_columns::shape *>(data_ + h.shapes_at);
+    blocks_ = reinterpret_cast<const geo_columns::block *>(data_ + h.blocks_at);
+    block_shift_ = 0;
+    while ((std::uint32_t(1) << block_shift_) < h.block_points)
+      ++block_shift_;
+
+    // Blocks are full but for the last, and hold all points.
+    if (h.blocks != (h.points >> block_shift_) +
+                        ((h.points & (h.block_points - 1)) != 0))
+      return false;
+    for (std::uint64_t i = 0; i < h.blocks; ++i) {
+      const geo_columns::block &b = blocks_[i];
+      const std::uint64_t points =
+          i + 1 < h.blocks ? h.block_points : h.points - (i << block_shift_);
+      if (b.points != points)
+        return false;
+      std::uint64_t extent = 0;
+      for (std::uint8_t width : b.width) {
+        if (width != 1 && width != 2 && width != 4)
+          return false;
+        extent += geo_columns::padded(points * width);
+      }
+      if (b.columns_at > size_ || extent > size_ - b.columns_at)
+        return false;
+    }
+
+    // Shapes follow each other; an empty one starts where the next does.
+    std::uint64_t first = 0;
+    for (std::uint64_t i = 0; i < h.shapes; ++i) {
+      if (shapes_[i].first < first || shapes_[i].first > h.points)
+        return false;
+      first = shapes_[i].first;
+    }
+    return h.shapes == 0 || shapes_[0].first == 0;
+  }
+
+  const char *data_ = nullptr;
+  std::size_t size_ = 0;
+  const geo_columns::file_header *header_ = nullptr;
+  const geo_columns::shape *shapes_ = nullptr;
+  const geo_columns::block *blocks_ = nullptr;
+  unsigned block_shift_ = 0;
+  double inverse_scale_ = 1;
+};
+
+geo_column_iterator::geo_column_iterator(const geo_column_store *store,
+                                         std::uint64_t index,
+                                         std::uint64_t end,
+                                         const std::int32_t *xy)
+    : store_(store), blocks_(store->blocks_), index_(index), end_(end),
+      block_mask_((std::uint64_t(1) << store->block_shift_) - 1),
+      block_shift_(store->block_shift_), x_(xy[0]), y_(xy[1]) {
+  if (index_ < end_)
+    enter(index_ >> block_shift_);
+}
+
+point geo_column_iterator::operator*() const {
+  return store_->dequantize(static_cast<std::int32_t>(x_),
+                            static_cast<std::int32_t>(y_));
+}
+
+void geo_column_iterator::enter(std::uint64_t block) {
+  const geo_columns::block &b = blocks_[block];
+  dx_ = store_->data_ + b.columns_at;
+  dy_ = dx_ + geo_columns::padded(b.points * b.width[0]);
+  width_[0] = b.width[0];
+  width_[1] = b.width[1];
+}
+
+/**
+ * A column file of lines or rings.
+ */
+template <typename GeoData> class geo_column_file : public geo_column_store {
+public:
+  using view = geo_column_view<GeoData>;
+
+  explicit geo_column_file(const std::string &path) : geo_column_store(path) {
+    if (type() != geo_codec<GeoData>::type)
+      throw std::runtime_error("geo_column_file: other type of geo data in " +
+                               path);
+  }
+
+  view operator[](std::size_t i) const {
+    return view(this, shape(i), shape_end(i));
+  }
+
+  /**
+   * Call f(i, view) for every shape with points in a block whose bounding
+   * box intersects box: candidates, for f to test exactly. Blocks outside
+   * the box are not read.
+   */
+  template <typename F> void query(const boost::geometry::model::box<point> &box,
+                                   F &&f) const {
+    const std::int32_t min[2] = {quantize(box.min_corner().get<0>(), 0),
+                                 quantize(box.min_corner().get<1>(), 1)};
+    const std::int32_t max[2] = {quantize(box.max_corner().get<0>(), 0),
+                                 quantize(box.max_corner().get<1>(), 1)};
+    std::size_t next = 0; // shapes before have been reported
+    for (std::size_t i = 0; i < blocks(); ++i) {
+      const geo_columns::block &b = block(i);
+      if (b.max[0] < min[0] || b.min[0] > max[0] || b.max[1] < min[1] ||
+          b.min[1] > max[1])
+        continue;
+      auto [from, to] = shapes_of(i);
+      for (std::size_t s = std::max(from, next); s < to; ++s)
+        if (shape_end(s) > shape(s).first)
+          f(s, (*this)[s]);
+      next = std::max(next, to);
+    }
+  }
+};
+
+/**
+ * Writes lines or rings into a column file, one block at a time.
+ */
+template <typename GeoData> class geo_column_writer {
+public:
+  /**
+   * block_points is rounded up to a power of two.
+   */
+  geo_column_writer(const std::string &path, point origin, double scale = 100,
+                    std::uint32_t block_points = 4096) {
+    header_ = geo_columns::file_header{};
+    std::memcpy(header_.magic, geo_columns::magic, sizeof(geo_columns::magic));
+    header_.type = geo_codec<GeoData>::type;
+    header_.block_points = 1;
+    while (header_.block_points < block_points)
+      header_.block_points <<= 1;
+    header_.origin[0] = origin.get<0>();
+    header_.origin[1] = origin.get<1>();
+    header_.scale = scale;
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0)
+      throw std::runtime_error("geo_column_writer: cannot create " + path);
+    offset_ = sizeof(header_);
+    try {
+      write_at(&header_, sizeof(header_), 0);
+    } catch (...) {
+      ::close(fd_);
+      fd_ = -1;
+      throw;
+    }
+  }
+
+  geo_column_writer(const geo_column_writer &) = delete;
+  geo_column_writer &operator=(const geo_column_writer &) = delete;
+
+  /**
+   * Errors of the last writes are lost here; call close() to see them.
+   */
+  ~geo_column_writer() {
+    if (fd_ >= 0) {
+      try {
+        close();
+      } catch (...) {
+        // Nothing sensible to do in a destructor; the file is incomplete.
+      }
+    }
+  }
+
+  /**
+   * Append a shape; the i-th shape added is file[i], empty ones too.
+   */
+  void add(const GeoData &data) {
+    geo_columns::shape s{header_.points, {}, {}};
+    std::int32_t previous[2] = {0, 0};
+    bool first = true;
+    for (const point &p : data) {
+      const std::int32_t q[2] = {quantize(p.get<0>(), 0),
+                                 quantize(p.get<1>(), 1)};
+      // The first point of a shape is in the shape itself.
+      if (first) {
+        s.first_xy[0] = q[0];
+        s.first_xy[1] = q[1];
+        push(q, q);
+        first = false;
+      } else {
+        push(q, previous);
+      }
+      previous[0] = q[0];
+      previous[1] = q[1];
+    }
+    s.last_xy[0] = previous[0];
+    s.last_xy[1] = previous[1];
+    shapes_.push_back(s);
+  }
+
+  /**
+   * Write the last block, the shapes and the block directory, and close the
+   * file. Throws if any of it fails; the file is closed either way.
+   */
+  void close() {
+    const int fd = fd_;
+    try {
+      if (!block_xy_[0].empty())
+        write_block();
+      header_.shapes = shapes_.size();
+      header_.blocks = blocks_.size();
+      header_.shapes_at = offset_;
+      write(shapes_.data(), shapes_.size() * sizeof(geo_columns::shape));
+      header_.blocks_at = offset_;
+      write(blocks_.data(), blocks_.size() * sizeof(geo_columns::block));
+      write_at(&header_, sizeof(header_), 0);
+    } catch (...) {
+      fd_ = -1;
+      ::close(fd);
+      throw;
+    }
+    fd_ = -1;
+    if (::close(fd) != 0)
+      throw std::runtime_error("geo_column_writer: close failed");
+  }
+
+private:
+  std::int32_t quantize(double v, int axis) const {
+    const double q = std::round((v - header_.origin[axis]) * header_.scale);
+    if (!(q >= INT32_MIN && q <= INT32_MAX))
+      throw std::range_error("geo_column_writer: coordinate out of range");
+    return static_cast<std::int32_t>(q);
+  }
+
+  void push(const std::int32_t *q, const std::int32_t *previous) {
+    // A block starts with the absolute point, in the block directory.
+    const bool starts_block = block_xy_[0].empty();
+    for (int axis = 0; axis < 2; ++axis) {
+      block_xy_[axis].push_back(q[axis]);
+      block_delta_[axis].push_back(
+          starts_block ? 0
+                       : static_cast<std::int32_t>(
+                             std::uint32_t(q[axis]) -
+                             std::uint32_t(previous[axis])));
+    }
+    ++header_.points;
+    if (block_xy_[0].size() == header_.block_points)
+      write_block();
+  }
+
+  void write_block() {
+    geo_columns::block b{};
+    b.points = block_xy_[0].size();
+    b.columns_at = offset_;
+    for (int axis = 0; axis < 2; ++axis) {
+      const std::vector<std::int32_t> &xy = block_xy_[axis];
+      b.first[axis] = xy.front();
+      b.last[axis] = xy.back();
+      b.min[axis] = *std::min_element(xy.begin(), xy.end());
+      b.max[axis] = *std::max_element(xy.begin(), xy.end());
+      b.width[axis] = width(block_delta_[axis]);
+    }
+    for (int axis = 0; axis < 2; ++axis) {
+      column_.assign(geo_columns::padded(b.points * b.width[axis]), 0);
+      char *at = column_.data();
+      for (std::int32_t d : block_delta_[axis]) {
+        if (b.width[axis] == 1) {
+          *at++ = static_cast<char>(d);
+        } else if (b.width[axis] == 2) {
+          const std::int16_t d16 = static_cast<std::int16_t>(d);
+          std::memcpy(at, &d16, 2);
+          at += 2;
+        } else {
+          std::memcpy(at, &d, 4);
+          at += 4;
+        }
+      }
+      write(column_.data(), column_.size());
+      block_xy_[axis].clear();
+      block_delta_[axis].clear();
+    }
+    blocks_.push_back(b);
+  }
+
+  static std::uint8_t width(const std::vector<std::int32_t> &deltas) {
+    std::int32_t largest = 0;
+    for (std::int32_t d : deltas)
+      largest = std::max(largest, d < 0 ? -(d + 1) : d);
+    return largest <= INT8_MAX ? 1 : largest <= INT16_MAX ? 2 : 4;
+  }
+
+  void write(const void *p, std::size_t n) {
+    write_at(p, n, offset_);
+    offset_ += n;
+  }
+
+  void write_at(const void *p, std::size_t n, std::size_t offset) {
+    const char *b = static_cast<const char *>(p);
+    while (n > 0) {
+      const ssize_t w = ::pwrite(fd_, b, n, offset);
+      if (w < 0 && errno == EINTR)
+        continue;
+      if (w <= 0)
+        throw std::runtime_error("geo_column_writer: write failed");
+      b += w;
+      n -= w;
+      offset += w;
+    }
+  }
+
+  int fd_ = -1;
+  std::size_t offset_ = 0;
+  geo_columns::file_header header_;
+  std::vector<geo_columns::shape> shapes_;
+  std::vector<geo_columns::block> blocks_;
+  std::vector<std::int32_t> block_xy_[2];
+  std::vector<std::int32_t> block_delta_[2];
+  std::vector<char> column_;
+};
+
+namespace boost {
+namespace geometry {
+namespace traits {
+
+template <> struct tag<geo_column_view<line>> {
+  using type = linestring_tag;
+};
+
+template <> struct tag<geo_column_view<ring>> {
+  using type = ring_tag;
+};
+
+} // namespace traits
+} // namespace geometry
+} // namespace boost
+
+#endif /* end of include guard: GEO_COLUMNS_H */
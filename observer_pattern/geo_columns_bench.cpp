@@ -0,0 +1,115 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "geo_columns.h"
+#include "geometry.h"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * A season of field boundaries--200000 rings of 32 to 256 points, laid out
+ * along a grid of fields in meters--written to a column file, opened, and
+ * scanned in full and through a small query box. Pass the directory for the
+ * file as argument.
+ */
+using clock_type = std::chrono::steady_clock;
+
+static double seconds_since(clock_type::time_point start) {
+  return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+static std::vector<ring> create_fields(std::size_t count) {
+  std::mt19937 random(42);
+  std::uniform_int_distribution<int> points(32, 256);
+  std::uniform_real_distribution<double> wobble(-2.0, 2.0);
+  const double pi = std::acos(-1.0);
+  std::vector<ring> fields;
+  fields.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    // Fields of about 150 m across on a 500 x 400 grid.
+    const double cx = 200.0 * (i % 500), cy = 200.0 * (i / 500);
+    const int n = points(random);
+    ring field;
+    for (int k = n - 1; k >= 0; --k) {
+      const double angle = 2 * pi * k / n, radius = 75 + wobble(random);
+      field.push_back(point{cx + radius * std::cos(angle),
+                            cy + radius * std::sin(angle)});
+    }
+    field.push_back(field.front());
+    fields.push_back(std::move(field));
+  }
+  return fields;
+}
+
+int main(int argc, char *argv[]) {
+  namespace bg = boost::geometry;
+  const std::string path =
+      std::string(argc > 1 ? argv[1] : ".") + "/geo_columns_bench.columns";
+  const std::vector<ring> fields = create_fields(200000);
+
+  std::size_t points = 0;
+  for (const ring &field : fields)
+    points += field.size();
+
+  auto start = clock_type::now();
+  {
+    geo_column_writer<ring> writer(path, point{0.0, 0.0}, 100);
+    for (const ring &field : fields)
+      writer.add(field);
+    writer.close();
+  }
+  const double written = seconds_since(start);
+
+  start = clock_type::now();
+  geo_column_file<ring> file(path);
+  const double opened = seconds_since(start);
+
+  std::cout << points << " points: " << file.bytes() / 1e6 << " MB on disk, "
+            << points * sizeof(point) / 1e6 << " MB as doubles; written in "
+            << written << " s, opened in " << opened * 1e6 << " us\n";
+
+  start = clock_type::now();
+  double area = 0;
+  for (const ring &field : fields)
+    area += bg::area(field);
+  const double in_memory = seconds_since(start);
+
+  start = clock_type::now();
+  double mapped_area = 0;
+  for (std::size_t i = 0; i < file.size(); ++i)
+    mapped_area += bg::area(file[i]);
+  const double mapped = seconds_since(start);
+
+  std::cout << "area of all fields: " << in_memory * 1e3
+            << " ms from vector<ring>, " << mapped * 1e3
+            << " ms from the file (difference " << mapped_area - area
+            << " m2 of " << area << ")\n";
+
+  // A box around 100 fields.
+  const bg::model::box<point> box{point{20000.0, 20000.0},
+                                  point{22000.0, 22000.0}};
+  start = clock_type::now();
+  std::size_t candidates = 0, hits = 0;
+  file.query(box, [&](std::size_t, const geo_column_view<ring> &field) {
+    ++candidates;
+    hits += bg::intersects(field, box);
+  });
+  const double queried = seconds_since(start);
+  std::size_t blocks = 0;
+  for (std::size_t i = 0; i < file.blocks(); ++i) {
+    const geo_columns::block &b = file.block(i);
+    blocks += b.max[0] >= 2000000 && b.min[0] <= 2200000 &&
+              b.max[1] >= 2000000 && b.min[1] <= 2200000;
+  }
+  std::cout << "query: " << hits << " fields of " << candidates
+            << " candidates from " << blocks << " of " << file.blocks()
+            << " blocks in " << queried * 1e6 << " us\n";
+
+  ::unlink(path.c_str());
+  return 0;
+}
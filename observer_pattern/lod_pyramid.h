@@ -0,0 +1,255 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef LOD_PYRAMID_H
+#define LOD_PYRAMID_H
+
+#include "../common/worker_pool.h"
+#include "geometry.h"
+#include "quantized_geometry.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Douglas-Peucker significance of every vertex of a line or ring: the
+ * largest tolerance at which the vertex survives simplification. The
+ * vertices with significance above t are exactly what Douglas-Peucker keeps
+ * at tolerance t, so one pass serves every tolerance.
+ *
+ * Rings are split at the vertex farthest from the first, and keep at least
+ * four vertices.
+ */
+template <typename GeoData>
+void douglas_peucker_significance(const GeoData &data,
+                                  std::vector<double> &significance,
+                                  std::vector<double> &xy) {
+  constexpr double keep = std::numeric_limits<double>::infinity();
+  const std::size_t n = data.size();
+  significance.assign(n, 0.0);
+  xy.clear();
+  for_each_point(data, [&](double x, double y) {
+    xy.push_back(x);
+    xy.push_back(y);
+  });
+  if (n <= 2) {
+    significance.assign(n, keep);
+    return;
+  }
+
+  // Squared distance of vertex i from the segment (a, b).
+  auto distance2 = [&](std::size_t a, std::size_t b, std::size_t i) {
+    const double ax = xy[2 * a], ay = xy[2 * a + 1];
+    const double dx = xy[2 * b] - ax, dy = xy[2 * b + 1] - ay;
+    const double px = xy[2 * i] - ax, py = xy[2 * i + 1] - ay;
+    const double length2 = dx * dx + dy * dy;
+    double t = length2 > 0 ? (px * dx + py * dy) / length2 : 0;
+    t = std::clamp(t, 0.0, 1.0);
+    const double ex = px - t * dx, ey = py - t * dy;
+    return ex * ex + ey * ey;
+  };
+
+  struct span {
+    std::size_t first, last;
+    double limit; // significance of the vertex that split the parent
+  };
+  std::vector<span> stack;
+  significance[0] = significance[n - 1] = keep;
+  if (std::is_same_v<typename boost::geometry::tag<GeoData>::type,
+                     boost::geometry::ring_tag>) {
+    std::size_t far = 1;
+    double farthest = -1;
+    for (std::size_t i = 1; i + 1 < n; ++i) {
+      const double dx = xy[2 * i] - xy[0], dy = xy[2 * i + 1] - xy[1];
+      const double d = dx * dx + dy * dy;
+      if (d > farthest) {
+        farthest = d;
+        far = i;
+      }
+    }
+    significance[far] = keep;
+    stack.push_back({0, far, keep});
+    stack.push_back({far, n - 1, keep});
+  } else {
+    stack.push_back({0, n - 1, keep});
+  }
+
+  while (!stack.empty()) {
+    const span s = stack.back();
+    stack.pop_back();
+    if (s.last - s.first < 2)
+      continue;
+    std::size_t split = s.first + 1;
+    double farthest = -1;
+    for (std::size_t i = s.first + 1; i < s.last; ++i) {
+      const double d = distance2(s.first, s.last, i);
+      if (d > farthest) {
+        farthest = d;
+        split = i;
+      }
+    }
+    // No vertex outlives the vertex that made its span.
+    const double sig = std::min(std::sqrt(farthest), s.limit);
+    significance[split] = sig;
+    stack.push_back({s.first, split, sig});
+    stack.push_back({split, s.last, sig});
+  }
+
+  if (std::is_same_v<typename boost::geometry::tag<GeoData>::type,
+                     boost::geometry::ring_tag> &&
+      n >= 4) {
+    // A fourth vertex, so the ring keeps an area.
+    std::size_t best = 1;
+    for (std::size_t i = 1; i + 1 < n; ++i) {
+      if (significance[i] != keep &&
+          (significance[best] == keep || significance[i] > significance[best]))
+        best = i;
+    }
+    significance[best] = keep;
+  }
+}
+
+/**
+ * Tolerances of the levels of a pyramid: level 0 is the geo data itself,
+ * level i > 0 is simplified at finest * factor^(i - 1).
+ */
+struct lod_tolerances {
+  double finest = 0.05;
+  double factor = 2;
+  unsigned levels = 8;
+
+  double operator[](unsigned level) const {
+    return level == 0 ? 0 : finest * std::pow(factor, level - 1);
+  }
+};
+
+template <typename Points>
+quantized_points<Points> empty_like(const quantized_points<Points> &data) {
+  return quantized_points<Points>(data.origin());
+}
+
+template <typename GeoData> GeoData empty_like(const GeoData &) {
+  return GeoData();
+}
+
+/**
+ * A line or ring at several levels of detail. Levels that simplify to the
+ * same vertices as the previous one are stored once.
+ */
+template <typename GeoData> class lod_pyramid {
+public:
+  lod_pyramid() = default;
+
+  /**
+   * Build the pyramid; significance and xy are scratch space.
+   */
+  lod_pyramid(const GeoData &data, const lod_tolerances &tolerances,
+              std::vector<double> &significance, std::vector<double> &xy)
+      : tolerances_(tolerances) {
+    douglas_peucker_significance(data, significance, xy);
+    levels_.push_back(data);
+    level_of_.push_back(0);
+    std::size_t kept = data.size();
+    for (unsigned level = 1; level < tolerances.levels; ++level) {
+      const double tolerance = tolerances[level];
+      std::size_t count = 0;
+      for (double s : significance)
+        count += s > tolerance;
+      if (count < kept) {
+        GeoData simplified = empty_like(data);
+        simplified.reserve(count);
+        for (std::size_t i = 0; i < data.size(); ++i)
+          if (significance[i] > tolerance)
+            simplified.push_back(data[i]);
+        levels_.push_back(std::move(simplified));
+        kept = count;
+      }
+      level_of_.push_back(levels_.size() - 1);
+    }
+  }
+
+  std::size_t levels() const { return level_of_.size(); }
+
+  const GeoData &level(unsigned level) const {
+    return levels_[level_of_[level]];
+  }
+
+  /**
+   * The coarsest level that deviates at most tolerance from the geo data.
+   */
+  const GeoData &for_tolerance(double tolerance) const {
+    unsigned level = 0;
+    while (level + 1 < levels() && tolerances_[level + 1] <= tolerance)
+      ++level;
+    return this->level(level);
+  }
+
+  /**
+   * Vertices stored, over all levels.
+   */
+  std::size_t vertices() const {
+    std::size_t n = 0;
+    for (const GeoData &l : levels_)
+      n += l.size();
+    return n;
+  }
+
+private:
+  lod_tolerances tolerances_;
+  std::vector<GeoData> levels_;
+  std::vector<std::uint8_t> level_of_;
+};
+
+/**
+ * Builds pyramids for batches of geo data on a pool of threads; the calling
+ * thread is one of them. Threads take shapes in chunks of 16.
+ */
+template <typename GeoData> class lod_builder {
+public:
+  explicit lod_builder(
+      lod_tolerances tolerances = {},
+      unsigned threads = std::max(1u, std::thread::hardware_concurrency()))
+      : tolerances_(tolerances), scratch_(threads), pool_(threads) {}
+
+  const lod_tolerances &tolerances() const { return tolerances_; }
+
+  /**
+   * Append the pyramids of batch to pyramids, in order, and return when
+   * all are built. Not reentrant.
+   */
+  void build(const std::vector<GeoData> &batch,
+             std::vector<lod_pyramid<GeoData>> &pyramids) {
+    const std::size_t offset = pyramids.size();
+    pyramids.resize(offset + batch.size());
+    pool_.run((batch.size() + chunk - 1) / chunk,
+              [&](std::size_t c, unsigned thread) {
+                scratch &s = scratch_[thread];
+                const std::size_t last =
+                    std::min(batch.size(), (c + 1) * chunk);
+                for (std::size_t i = c * chunk; i < last; ++i)
+                  pyramids[offset + i] = lod_pyramid<GeoData>(
+                      batch[i], tolerances_, s.significance, s.xy);
+              });
+  }
+
+private:
+  static constexpr std::size_t chunk = 16;
+
+  struct scratch {
+    std::vector<double> significance;
+    std::vector<double> xy;
+  };
+
+  const lod_tolerances tolerances_;
+  std::vector<scratch> scratch_; // one per thread
+  worker_pool pool_;
+};
+
+#endif /* end of include guard: LOD_PYRAMID_H */
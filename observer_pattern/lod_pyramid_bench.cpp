@@ -0,0 +1,83 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "geometry.h"
+#include "lod_pyramid.h"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/**
+ * Level of detail pyramids of 100000 recorded paths of 64 to 1024 points: how
+ * fast they are built, against boost::geometry::simplify at every level, and
+ * how many vertices each level keeps.
+ */
+using clock_type = std::chrono::steady_clock;
+
+static double seconds_since(clock_type::time_point start) {
+  return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+int main() {
+  std::mt19937 random(42);
+  std::uniform_int_distribution<int> points(64, 1024);
+  std::normal_distribution<double> noise(0.0, 0.05);
+  std::vector<line> paths;
+  std::size_t vertices = 0;
+  for (int i = 0; i < 100000; ++i) {
+    // A tractor track: 1 m steps along a slowly turning heading, with GNSS
+    // noise.
+    line path;
+    double x = 0, y = 0, heading = 0;
+    for (int k = points(random); k > 0; --k) {
+      heading += 0.02 * std::sin(k / 50.0);
+      x += std::cos(heading);
+      y += std::sin(heading);
+      path.push_back(point{x + noise(random), y + noise(random)});
+    }
+    vertices += path.size();
+    paths.push_back(std::move(path));
+  }
+
+  const lod_tolerances tolerances;
+  for (unsigned threads : {1u, 4u}) {
+    lod_builder<line> builder(tolerances, threads);
+    std::vector<lod_pyramid<line>> pyramids;
+    auto start = clock_type::now();
+    builder.build(paths, pyramids);
+    std::cout << threads << " thread(s): " << vertices / seconds_since(start)
+              << " vertices/s\n";
+    if (threads > 1)
+      continue;
+
+    std::vector<std::size_t> kept(tolerances.levels);
+    for (const lod_pyramid<line> &pyramid : pyramids)
+      for (unsigned level = 0; level < tolerances.levels; ++level)
+        kept[level] += pyramid.level(level).size();
+
+    // Douglas-Peucker level by level, as boost::geometry::simplify does.
+    std::vector<std::size_t> simplified(tolerances.levels);
+    start = clock_type::now();
+    line out;
+    for (const line &path : paths) {
+      for (unsigned level = 1; level < tolerances.levels; ++level) {
+        out.clear();
+        boost::geometry::simplify(path, out, tolerances[level]);
+        simplified[level] += out.size();
+      }
+    }
+    std::cout << "boost::geometry::simplify at every level: "
+              << vertices / seconds_since(start) << " vertices/s\n";
+    for (unsigned level = 0; level < tolerances.levels; ++level) {
+      std::cout << "level " << level << " (tolerance " << tolerances[level]
+                << "): " << kept[level] << " vertices";
+      if (level > 0)
+        std::cout << ", simplify keeps " << simplified[level];
+      std::cout << "\n";
+    }
+  }
+  return 0;
+}
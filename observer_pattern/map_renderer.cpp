@@ -2,9 +2,16 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+#include "geo_capture.h"
 #include "geometry.h"
+#include "lod_pyramid.h"
+#include "quantized_geometry.h"
+#include "rasterizer.h"
+#include "tiled_map.h"
+#include <chrono>
 #include <iostream>
 #include <list>
+#include <string>
 
 /**
  * Interface for map_renderers that render geo data.
@@ -17,19 +24,42 @@ public:
    * Render geo data and add details to a map.
    */
   virtual void render(GeoData data) = 0;
+
+  /**
+   * How far, in map units, geo data may be simplified before it shows in
+   * the map. 0 renders every vertex.
+   */
+  virtual double tolerance() const { return 0; }
+
   virtual ~map_renderer() = default;
 };
 
 /**
- * Render paths into a map.
+ * Render paths into a map: lines, or the outlines of rings.
  */
 template <typename T> class path_map_renderer : public map_renderer<T> {
 public:
   using GeoData = typename map_renderer<T>::GeoData;
+
+  path_map_renderer(framebuffer &map, map_view view,
+                    rgba color = make_rgba(40, 40, 40), float width = 2)
+      : map_(map), view_(view), color_(color), width_(width) {}
+
+  /**
+   * Deviations below half a pixel do not show.
+   */
+  double tolerance() const override { return view_.units_per_pixel / 2; }
+
   void render(GeoData data) {
-    //    std::cout << "Render path"
-    //              << "\n";
+    drawer_.draw(map_, view_, data, color_, width_);
   }
+
+private:
+  framebuffer &map_;
+  map_view view_;
+  rgba color_;
+  float width_;
+  line_drawer drawer_;
 };
 
 /**
@@ -38,10 +68,58 @@ public:
 template <typename T> class field_map_renderer : public map_renderer<T> {
 public:
   using GeoData = typename map_renderer<T>::GeoData;
-  void render(GeoData data) {
-    //    std::cout << "Render field"
-    //              << "\n";
+
+  field_map_renderer(framebuffer &map, map_view view,
+                     rgba color = make_rgba(110, 170, 60, 160))
+      : map_(map), view_(view), color_(color) {}
+
+  double tolerance() const override { return view_.units_per_pixel / 2; }
+
+  void render(GeoData data) { filler_.fill(map_, view_, data, color_); }
+
+private:
+  framebuffer &map_;
+  map_view view_;
+  rgba color_;
+  polygon_filler filler_;
+};
+
+/**
+ * Add geo data to a tiled map, as shapes of one style; the map draws them
+ * when it renders its next frame.
+ */
+template <typename T> class tiled_map_renderer : public map_renderer<T> {
+public:
+  using GeoData = typename map_renderer<T>::GeoData;
+
+  tiled_map_renderer(tiled_map<GeoData> &map, map_style style)
+      : map_(map), style_(style) {}
+
+  double tolerance() const override {
+    return map_.view().units_per_pixel / 2;
   }
+
+  void render(GeoData data) { map_.add(std::move(data), style_); }
+
+private:
+  tiled_map<GeoData> &map_;
+  map_style style_;
+};
+
+/**
+ * Record geo data into a capture, for replaying it later.
+ */
+template <typename T> class recording_map_renderer : public map_renderer<T> {
+public:
+  using GeoData = typename map_renderer<T>::GeoData;
+
+  explicit recording_map_renderer(geo_recorder &recorder)
+      : recorder_(recorder) {}
+
+  void render(GeoData data) { recorder_(data); }
+
+private:
+  geo_recorder &recorder_;
 };
 
 /**
@@ -95,29 +173,203 @@ private:
   RendererContainer map_renderers_;
 };
 
-int main(int argc, char *argv[]) {
-  ecu_geo_data_provider<ring> provider;
+/**
+ * Between a provider and renderers: simplifies geo data into level of
+ * detail pyramids and sends every renderer the coarsest level within its
+ * tolerance. Geo data is simplified in parallel, a batch at a time, and
+ * passed on in order: when the batch is full, when its first shape has
+ * waited max_delay, or on flush(), which providers call when their stream
+ * goes idle. The last keep pyramids are kept, so redraw() renders them again
+ * at new tolerances without simplifying again; by default none are.
+ */
+template <typename T>
+class lod_map_renderer : public map_renderer<T>, public geo_data_provider<T> {
+public:
+  using GeoData = T;
+  using clock = std::chrono::steady_clock;
 
-  map_renderer<ring> *path_renderer = new path_map_renderer<ring>();
-  map_renderer<ring> *field_renderer = new field_map_renderer<ring>();
+  explicit lod_map_renderer(
+      std::size_t batch = 1024, lod_tolerances tolerances = {},
+      std::size_t keep = 0,
+      clock::duration max_delay = std::chrono::milliseconds(100))
+      : batch_(batch), keep_(keep), max_delay_(max_delay),
+        builder_(tolerances) {
+    pending_.reserve(batch);
+  }
 
-  provider.register_map_renderer(path_renderer);
-  provider.register_map_renderer(field_renderer);
+  void register_map_renderer(map_renderer<GeoData> *renderer) override {
+    map_renderers_.push_back(renderer);
+  }
+
+  void unregister_map_renderer(map_renderer<GeoData> *renderer) override {
+    map_renderers_.remove(renderer);
+  }
 
+  void send_geo_data(GeoData data) override { render(std::move(data)); }
+
+  void render(GeoData data) override {
+    const auto now = clock::now();
+    if (pending_.empty())
+      oldest_ = now;
+    pending_.push_back(std::move(data));
+    if (pending_.size() >= batch_ || now - oldest_ >= max_delay_)
+      flush();
+  }
+
+  /**
+   * Simplify and pass on the geo data of an incomplete batch.
+   */
+  void flush() {
+    if (pending_.empty())
+      return;
+    const std::size_t first = pyramids_.size();
+    builder_.build(pending_, pyramids_);
+    pending_.clear();
+    send(first, pyramids_.size());
+    if (pyramids_.size() > keep_)
+      pyramids_.erase(pyramids_.begin(), pyramids_.end() - keep_);
+  }
+
+  /**
+   * Send the kept geo data again, after renderers changed their tolerance.
+   */
+  void redraw() { send(0, pyramids_.size()); }
+
+  /**
+   * The pyramids of the last keep shapes passed on, oldest first.
+   */
+  const std::vector<lod_pyramid<GeoData>> &pyramids() const {
+    return pyramids_;
+  }
+
+private:
+  /**
+   * Every shape goes to all renderers before the next one, as the emits
+   * came in: renderers drawing into the same map keep their layering.
+   */
+  void send(std::size_t first, std::size_t last) {
+    for (std::size_t i = first; i < last; ++i)
+      for (const auto renderer : map_renderers_)
+        renderer->render(pyramids_[i].for_tolerance(renderer->tolerance()));
+  }
+
+  std::size_t batch_;
+  std::size_t keep_;
+  clock::duration max_delay_;
+  clock::time_point oldest_;
+  lod_builder<GeoData> builder_;
+  std::vector<GeoData> pending_;
+  std::vector<lod_pyramid<GeoData>> pyramids_;
+  std::list<map_renderer<GeoData> *> map_renderers_;
+};
+
+/**
+ * Send geo data to a path and a field renderer: the field over and over, or
+ * the rings of a capture, converted to the model of GeoData. With lod, they
+ * receive it through a level of detail stage. With tiled, they add it to a
+ * tiled map, which renders a frame every 1024 emits and is copied into map.
+ */
+template <typename GeoData, typename Convert>
+void render_fields(framebuffer &map, const map_view &view, const ring &field,
+                   const char *capture, bool lod, bool tiled, Convert convert) {
+  ecu_geo_data_provider<GeoData> provider;
+  lod_map_renderer<GeoData> lod_stage;
+  geo_data_provider<GeoData> &source =
+      lod ? static_cast<geo_data_provider<GeoData> &>(lod_stage) : provider;
+  if (lod)
+    provider.register_map_renderer(&lod_stage);
+
+  tiled_map<GeoData> tiles(map.width(), map.height(), view,
+                           make_rgba(255, 255, 255));
+  map_renderer<GeoData> *path_renderer;
+  map_renderer<GeoData> *field_renderer;
+  if (tiled) {
+    path_renderer = new tiled_map_renderer<GeoData>(
+        tiles, map_style{0, make_rgba(40, 40, 40), 2});
+    field_renderer = new tiled_map_renderer<GeoData>(
+        tiles, map_style{make_rgba(110, 170, 60, 160), 0, 0});
+  } else {
+    path_renderer = new path_map_renderer<GeoData>(map, view);
+    field_renderer = new field_map_renderer<GeoData>(map, view);
+  }
+
+  source.register_map_renderer(path_renderer);
+  source.register_map_renderer(field_renderer);
+
+  std::size_t emitted = 0;
+  auto emit = [&](GeoData data) {
+    provider.send_geo_data(std::move(data));
+    if (tiled && ++emitted % 1024 == 0)
+      tiles.render();
+  };
+  const GeoData data = convert(field);
+  if (capture) {
+    // Replay a captured session as fast as possible instead.
+    geo_replayer replayer(capture);
+    replayer.replay([&](const ring &r) { emit(convert(r)); });
+  } else {
+    // The tiled map keeps every emit and the level of detail stage
+    // simplifies each, so fewer of them.
+    const int emits = tiled ? 100000 : lod ? 1000000 : 100000000;
+    for (int i = 0; i < emits; ++i) {
+      emit(data);
+    }
+  }
+  lod_stage.flush();
+
+  source.unregister_map_renderer(path_renderer);
+  provider.send_geo_data(data);
+  lod_stage.flush();
+  source.unregister_map_renderer(field_renderer);
+
+  if (tiled) {
+    tiles.render();
+    map = tiles.image();
+  }
+
+  delete path_renderer;
+  delete field_renderer;
+}
+
+/**
+ * map_renderer [--quantized] [--lod] [--tiled] [--png file] [capture]
+ */
+int main(int argc, char *argv[]) {
   point a{0.0, 0.0};
   point b{0.0, 5.0};
   point c{5.0, 5.0};
   point d{5.0, 0.0};
-  line path{a, b};
   ring field{a, b, c, d, a};
 
-  for (int i = 0; i < 100000000; ++i) {
-    provider.send_geo_data(field);
+  bool quantized = false, lod = false, tiled = false;
+  const char *capture = nullptr;
+  const char *png = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--quantized")
+      quantized = true;
+    else if (arg == "--lod")
+      lod = true;
+    else if (arg == "--tiled")
+      tiled = true;
+    else if (arg == "--png" && i + 1 < argc)
+      png = argv[++i];
+    else
+      capture = argv[i];
   }
 
-  provider.unregister_map_renderer(path_renderer);
-  provider.send_geo_data(field);
-  provider.unregister_map_renderer(field_renderer);
+  // A map at 10 cm per pixel around the field.
+  framebuffer map(256, 256, make_rgba(255, 255, 255));
+  const map_view view{-5.0, -5.0, 0.1, map.height()};
+  if (quantized) {
+    render_fields<quantized_ring>(map, view, field, capture, lod, tiled,
+                                  [](const ring &r) { return quantize(r); });
+  } else {
+    render_fields<ring>(map, view, field, capture, lod, tiled,
+                        [](const ring &r) { return r; });
+  }
+  if (png)
+    map.write_png(png);
 
   return 0;
 }
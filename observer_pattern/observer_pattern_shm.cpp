@@ -0,0 +1,56 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "geometry.h"
+#include "observers.h"
+#include "shm_signal.h"
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+
+/**
+ * The ECU ingest and the map renderer as two processes, connected by a
+ * signal over shared memory.
+ */
+int main(int argc, char *argv[]) {
+  const std::string name = "/observer_pattern_shm";
+  const int emits = 1000000;
+
+  shm_signal_publisher ingest(name);
+
+  if (::fork() == 0) {
+    {
+      shm_signal_subscriber renderer(name);
+      int lines = 0, rings = 0;
+      renderer.on<line>().connect(path_renderer);
+      renderer.on<line>().connect([&](const line &) { ++lines; });
+      renderer.on<ring>().connect(path_renderer);
+      renderer.on<ring>().connect(field_renderer);
+      renderer.on<ring>().connect([&](const ring &) { ++rings; });
+      while (rings < emits)
+        renderer.poll(1000000);
+      std::cout << "Renderer received " << lines << " line(s) and " << rings
+                << " ring(s)\n";
+    }
+    // Leaves the inherited publisher alone: the ring is the parent's.
+    std::exit(0);
+  }
+
+  point a{0.0, 0.0};
+  point b{0.0, 5.0};
+  point c{5.0, 5.0};
+  point d{5.0, 0.0};
+  line path{a, b};
+  ring field{a, b, c, d, a};
+
+  ingest.wait_for_subscribers(1);
+  ingest(path);
+  for (int i = 0; i < emits; ++i) {
+    ingest(field);
+  }
+
+  // The renderer detaches once it has seen every ring.
+  ingest.wait_for_detach();
+  return 0;
+}
@@ -3,7 +3,7 @@
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
 #include "geometry.h"
-//#include "inplace_function.h"
+//#include "../common/inplace_function.h"
 #include "observers.h"
 #include <any>
 #include <boost/signals2.hpp>
@@ -0,0 +1,209 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef QUANTIZED_GEOMETRY_H
+#define QUANTIZED_GEOMETRY_H
+
+#include "geometry.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+/**
+ * A second geometry model: int32 coordinates in centimeters relative to an
+ * origin, 8 bytes per vertex instead of 16. The origin belongs to the shape;
+ * shapes of one tile simply share the tile's origin.
+ *
+ * Areas are exact: twice_area sums integer cross products. Lengths sum the
+ * square roots of exact squared segment lengths.
+ */
+using quantized_point =
+    boost::geometry::model::point<std::int32_t, 2,
+                                  boost::geometry::cs::cartesian>;
+
+/**
+ * Quantized units per unit of the double model.
+ */
+static constexpr double quantized_scale = 100;
+
+template <typename Points> class quantized_points : public Points {
+public:
+  using Points::Points;
+
+  quantized_points() = default;
+  explicit quantized_points(point origin) : origin_(origin) {}
+
+  const point &origin() const { return origin_; }
+
+private:
+  point origin_{0.0, 0.0};
+};
+
+using quantized_line =
+    quantized_points<boost::geometry::model::linestring<quantized_point>>;
+using quantized_ring =
+    quantized_points<boost::geometry::model::ring<quantized_point>>;
+
+namespace boost {
+namespace geometry {
+namespace traits {
+
+template <> struct tag<quantized_line> {
+  using type = linestring_tag;
+};
+
+template <> struct tag<quantized_ring> {
+  using type = ring_tag;
+};
+
+} // namespace traits
+} // namespace geometry
+} // namespace boost
+
+/**
+ * The quantized model of double geo data, and back.
+ */
+template <typename GeoData> struct quantized_model;
+
+template <> struct quantized_model<line> {
+  using type = quantized_line;
+};
+
+template <> struct quantized_model<ring> {
+  using type = quantized_ring;
+};
+
+template <typename GeoData> struct double_model {
+  using type = GeoData;
+};
+
+template <> struct double_model<quantized_line> {
+  using type = line;
+};
+
+template <> struct double_model<quantized_ring> {
+  using type = ring;
+};
+
+inline std::int32_t quantize_coordinate(double v, double origin) {
+  const double q = std::round((v - origin) * quantized_scale);
+  if (!(q >= INT32_MIN && q <= INT32_MAX))
+    throw std::range_error("quantize: coordinate too far from the origin");
+  return static_cast<std::int32_t>(q);
+}
+
+/**
+ * Quantize relative to origin; by default the shape's first point.
+ */
+template <typename GeoData>
+typename quantized_model<GeoData>::type quantize(const GeoData &data,
+                                                 point origin) {
+  typename quantized_model<GeoData>::type q(origin);
+  q.reserve(data.size());
+  for (const point &p : data)
+    q.push_back(
+        quantized_point{quantize_coordinate(p.get<0>(), origin.get<0>()),
+                        quantize_coordinate(p.get<1>(), origin.get<1>())});
+  return q;
+}
+
+template <typename GeoData>
+typename quantized_model<GeoData>::type quantize(const GeoData &data) {
+  return quantize(data, data.empty() ? point{0.0, 0.0} : data.front());
+}
+
+/**
+ * Call f(x, y) with the coordinates of every point, in the double model.
+ */
+template <typename Points, typename F>
+void for_each_point(const quantized_points<Points> &data, F &&f) {
+  const double x0 = data.origin().template get<0>();
+  const double y0 = data.origin().template get<1>();
+  for (const quantized_point &p : data)
+    f(x0 + p.get<0>() / quantized_scale, y0 + p.get<1>() / quantized_scale);
+}
+
+template <typename GeoData, typename F>
+void for_each_point(const GeoData &data, F &&f) {
+  for (const point &p : data)
+    f(p.get<0>(), p.get<1>());
+}
+
+template <typename Points>
+typename double_model<quantized_points<Points>>::type
+dequantize(const quantized_points<Points> &data) {
+  typename double_model<quantized_points<Points>>::type d;
+  d.reserve(data.size());
+  for_each_point(data, [&](double x, double y) { d.push_back(point{x, y}); });
+  return d;
+}
+
+/**
+ * Twice the area, exactly, in square quantized units; positive for
+ * clockwise rings, as with boost::geometry::area. Exact as long as the
+ * result fits 63 bits, i.e. fields below 4.6e14 m2.
+ */
+inline std::int64_t twice_area(const quantized_ring &field) {
+  if (field.size() < 3)
+    return 0;
+  // Modulo 2^64, where intermediate overflow cancels out: the sum is exact
+  // whenever the result fits.
+  auto cross = [](const quantized_point &a, const quantized_point &b) {
+    return std::uint64_t(std::int64_t(b.get<0>()) * a.get<1>()) -
+           std::uint64_t(std::int64_t(a.get<0>()) * b.get<1>());
+  };
+  const quantized_point *p = field.data();
+  const std::size_t n = field.size();
+  // An open ring closes implicitly: the pair (last, first) is included,
+  // and adds nothing when the ring is closed.
+  std::uint64_t sum = cross(p[n - 1], p[0]);
+  for (std::size_t i = 1; i < n; ++i)
+    sum += cross(p[i - 1], p[i]);
+  return static_cast<std::int64_t>(sum);
+}
+
+/**
+ * Exact squared length of a segment, in square quantized units, for
+ * segments shorter than 2^31 units.
+ */
+inline std::uint64_t squared_length(const quantized_point &a,
+                                    const quantized_point &b) {
+  const std::uint64_t dx = std::abs(std::int64_t(b.get<0>()) - a.get<0>());
+  const std::uint64_t dy = std::abs(std::int64_t(b.get<1>()) - a.get<1>());
+  return dx * dx + dy * dy;
+}
+
+/**
+ * Area in the units of the double model, for either model.
+ */
+inline double area_of(const quantized_ring &field) {
+  return twice_area(field) / (2 * quantized_scale * quantized_scale);
+}
+
+inline double area_of(const ring &field) {
+  return boost::geometry::area(field);
+}
+
+/**
+ * Length in the units of the double model, for either model.
+ */
+template <typename Points>
+double length_of(const quantized_points<Points> &path) {
+  double sum = 0;
+  for (std::size_t i = 1; i < path.size(); ++i)
+    sum += std::sqrt(double(squared_length(path[i - 1], path[i])));
+  return sum / quantized_scale;
+}
+
+template <typename GeoData> double length_of(const GeoData &path) {
+  // boost::geometry::length is 0 for rings; theirs is the perimeter.
+  if constexpr (std::is_same_v<GeoData, ring>)
+    return boost::geometry::perimeter(path);
+  else
+    return boost::geometry::length(path);
+}
+
+#endif /* end of include guard: QUANTIZED_GEOMETRY_H */
@@ -0,0 +1,92 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "geometry.h"
+#include "quantized_geometry.h"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/**
+ * Area and length of 200000 field boundaries of 32 to 256 points, in the
+ * double and in the quantized model, and how far the two disagree.
+ */
+using clock_type = std::chrono::steady_clock;
+
+template <typename F> static double milliseconds(F &&f) {
+  const auto start = clock_type::now();
+  f();
+  return std::chrono::duration<double, std::milli>(clock_type::now() - start)
+      .count();
+}
+
+int main() {
+  namespace bg = boost::geometry;
+  std::mt19937 random(42);
+  std::uniform_int_distribution<int> points(32, 256);
+  std::uniform_real_distribution<double> wobble(-2.0, 2.0);
+  const double pi = std::acos(-1.0);
+
+  std::vector<ring> fields;
+  std::vector<quantized_ring> quantized_fields;
+  std::size_t vertices = 0;
+  for (std::size_t i = 0; i < 200000; ++i) {
+    const double cx = 200.0 * (i % 500), cy = 200.0 * (i / 500);
+    const int n = points(random);
+    ring field;
+    for (int k = n - 1; k >= 0; --k) {
+      const double angle = 2 * pi * k / n, radius = 75 + wobble(random);
+      // Centimeter precision, as measured.
+      field.push_back(
+          point{std::round((cx + radius * std::cos(angle)) * 100) / 100,
+                std::round((cy + radius * std::sin(angle)) * 100) / 100});
+    }
+    field.push_back(field.front());
+    vertices += field.size();
+    quantized_fields.push_back(quantize(field));
+    fields.push_back(std::move(field));
+  }
+
+  std::cout << vertices << " vertices: " << vertices * sizeof(point) / 1e6
+            << " MB as doubles, " << vertices * sizeof(quantized_point) / 1e6
+            << " MB quantized\n";
+
+  for (int round = 0; round < 2; ++round) {
+    double area = 0, exact_area = 0, length = 0, exact_length = 0;
+    const double area_double = milliseconds([&] {
+      for (const ring &field : fields)
+        area += area_of(field);
+    });
+    const double area_quantized = milliseconds([&] {
+      for (const quantized_ring &field : quantized_fields)
+        exact_area += area_of(field);
+    });
+    const double length_double = milliseconds([&] {
+      for (const ring &field : fields)
+        length += length_of(field);
+    });
+    const double length_quantized = milliseconds([&] {
+      for (const quantized_ring &field : quantized_fields)
+        exact_length += length_of(field);
+    });
+    std::cout << "area: " << area_double << " ms double, " << area_quantized
+              << " ms quantized (difference " << exact_area - area << " of "
+              << area << ")\n";
+    std::cout << "length: " << length_double << " ms double, "
+              << length_quantized << " ms quantized (difference "
+              << exact_length - length << " of " << length << ")\n";
+  }
+
+  // Boost.Geometry takes the quantized model too, in its own frame.
+  const quantized_ring &first = quantized_fields.front();
+  bg::model::box<quantized_point> box;
+  bg::envelope(first, box);
+  std::cout << "first field: boost::geometry::area " << bg::area(first)
+            << ", twice_area " << twice_area(first) << ", envelope "
+            << bg::dsv(box) << ", round trip error "
+            << bg::distance(dequantize(first)[7], fields.front()[7]) << "\n";
+  return 0;
+}
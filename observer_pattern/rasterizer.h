@@ -0,0 +1,430 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#include "quantized_geometry.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) && !defined(RASTERIZER_NO_SIMD)
+#include <emmintrin.h>
+#define RASTERIZER_SSE2 1
+#endif
+
+/**
+ * A color, as the bytes R, G, B, A in memory.
+ */
+using rgba = std::uint32_t;
+
+constexpr rgba make_rgba(std::uint8_t r, std::uint8_t g, std::uint8_t b,
+                         std::uint8_t a = 255) {
+  return rgba(r) | rgba(g) << 8 | rgba(b) << 16 | rgba(a) << 24;
+}
+
+/**
+ * An RGBA image in memory, rows top to bottom. Spans are filled and
+ * blended four pixels at a time with SSE2.
+ */
+class framebuffer {
+public:
+  framebuffer(int width, int height, rgba background = make_rgba(0, 0, 0, 0))
+      : width_(width), height_(height),
+        pixels_(std::size_t(width) * height, background) {}
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+
+  rgba *row(int y) { return &pixels_[std::size_t(y) * width_]; }
+  const rgba *row(int y) const { return &pixels_[std::size_t(y) * width_]; }
+  rgba pixel(int x, int y) const { return row(y)[x]; }
+
+  void clear(rgba color) { std::fill(pixels_.begin(), pixels_.end(), color); }
+
+  /**
+   * Blend color over pixels [x0, x1) of row y, clipped to the image.
+   */
+  void fill_span(int y, int x0, int x1, rgba color) {
+    if (y < 0 || y >= height_)
+      return;
+    x0 = std::max(x0, 0);
+    x1 = std::min(x1, width_);
+    if (x0 >= x1)
+      return;
+    rgba *p = row(y) + x0;
+    const int n = x1 - x0;
+    const unsigned alpha = color >> 24;
+    if (alpha == 255) {
+      int i = 0;
+#ifdef RASTERIZER_SSE2
+      const __m128i c = _mm_set1_epi32(int(color));
+      for (; i + 4 <= n; i += 4)
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p + i), c);
+#endif
+      for (; i < n; ++i)
+        p[i] = color;
+    } else if (alpha > 0) {
+      int i = 0;
+#ifdef RASTERIZER_SSE2
+      const __m128i a = _mm_set1_epi16(short(alpha));
+      for (; i + 4 <= n; i += 4)
+        blend4(p + i, color, a);
+#endif
+      for (; i < n; ++i)
+        blend(p[i], color, alpha);
+    }
+  }
+
+  /**
+   * Blend color over one pixel with coverage alpha (0 to 255), unclipped.
+   */
+  static void blend(rgba &dst, rgba color, unsigned alpha) {
+    rgba out = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+      const unsigned s = shift == 24 ? 255 : (color >> shift) & 255;
+      const unsigned d = (dst >> shift) & 255;
+      out |= rgba(div255(s * alpha + d * (255 - alpha))) << shift;
+    }
+    dst = out;
+  }
+
+#ifdef RASTERIZER_SSE2
+  /**
+   * Blend color over four pixels, each with its own alpha in the 16-bit
+   * lanes of alpha: a0 a0 a0 a0 a1 a1 a1 a1 for the first two, and so on.
+   */
+  static void blend4(rgba *dst, rgba color, __m128i alpha_lo,
+                     __m128i alpha_hi) {
+    const __m128i zero = _mm_setzero_si128();
+    // The alpha channel of the result is coverage over the destination.
+    const __m128i src =
+        _mm_unpacklo_epi8(_mm_set1_epi32(int(color | 0xff000000u)), zero);
+    const __m128i max = _mm_set1_epi16(255);
+    const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst));
+    __m128i lo = _mm_unpacklo_epi8(d, zero);
+    __m128i hi = _mm_unpackhi_epi8(d, zero);
+    lo = _mm_add_epi16(_mm_mullo_epi16(src, alpha_lo),
+                       _mm_mullo_epi16(lo, _mm_sub_epi16(max, alpha_lo)));
+    hi = _mm_add_epi16(_mm_mullo_epi16(src, alpha_hi),
+                       _mm_mullo_epi16(hi, _mm_sub_epi16(max, alpha_hi)));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst),
+                     _mm_packus_epi16(div255(lo), div255(hi)));
+  }
+
+  static void blend4(rgba *dst, rgba color, __m128i alpha) {
+    blend4(dst, color, alpha, alpha);
+  }
+#endif
+
+  /**
+   * Write the image as an uncompressed PNG.
+   */
+  void write_png(const std::string &path) const;
+
+private:
+  // x / 255, rounded, for x up to 255 * 255.
+  static unsigned div255(unsigned x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+  }
+
+#ifdef RASTERIZER_SSE2
+  static __m128i div255(__m128i x) {
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+  }
+#endif
+
+  int width_;
+  int height_;
+  std::vector<rgba> pixels_;
+};
+
+/**
+ * Maps map units to pixels: (x0, y0) is the lower left corner of the image.
+ */
+struct map_view {
+  double x0 = 0;
+  double y0 = 0;
+  double units_per_pixel = 1;
+  int height = 0;
+
+  double x(double map_x) const { return (map_x - x0) / units_per_pixel; }
+  double y(double map_y) const {
+    return height - (map_y - y0) / units_per_pixel;
+  }
+};
+
+/**
+ * Fill a ring by the even-odd rule, sampling pixel centers.
+ */
+class polygon_filler {
+public:
+  template <typename GeoData>
+  void fill(framebuffer &image, const map_view &view, const GeoData &ring,
+            rgba color) {
+    edges_.clear();
+    bool first = true;
+    float px = 0, py = 0, fx = 0, fy = 0;
+    for_each_point(ring, [&](double mx, double my) {
+      const float x = float(view.x(mx)), y = float(view.y(my));
+      if (first) {
+        fx = x;
+        fy = y;
+        first = false;
+      } else {
+        add_edge(px, py, x, y);
+      }
+      px = x;
+      py = y;
+    });
+    if (first)
+      return;
+    add_edge(px, py, fx, fy); // no-op for closed rings
+    if (edges_.empty())
+      return;
+
+    // Rows whose centers lie between an edge's ends cross it.
+    int top = image.height(), bottom = 0;
+    for (const edge &e : edges_) {
+      top = std::min(top, row_at_or_below(e.y0));
+      bottom = std::max(bottom, row_at_or_below(e.y1));
+    }
+    top = std::max(top, 0);
+    bottom = std::min(bottom, image.height());
+    std::sort(edges_.begin(), edges_.end(),
+              [](const edge &a, const edge &b) { return a.y0 < b.y0; });
+
+    active_.clear();
+    std::size_t next = 0;
+    for (int y = top; y < bottom; ++y) {
+      const float center = y + 0.5f;
+      while (next < edges_.size() && edges_[next].y0 <= center)
+        active_.push_back(edges_[next++]);
+      crossings_.clear();
+      std::size_t kept = 0;
+      for (std::size_t i = 0; i < active_.size(); ++i) {
+        const edge &e = active_[i];
+        if (e.y1 <= center)
+          continue;
+        active_[kept++] = e;
+        crossings_.push_back(e.x0 + (center - e.y0) * e.slope);
+      }
+      active_.resize(kept);
+      std::sort(crossings_.begin(), crossings_.end());
+      for (std::size_t i = 0; i + 1 < crossings_.size(); i += 2) {
+        // Pixels whose centers lie inside [a, b).
+        const int x0 = int(std::ceil(crossings_[i] - 0.5f));
+        const int x1 = int(std::ceil(crossings_[i + 1] - 0.5f));
+        image.fill_span(y, x0, x1, color);
+      }
+    }
+  }
+
+private:
+  struct edge {
+    float x0, y0, y1, slope; // from the upper end, y0 < y1
+  };
+
+  static int row_at_or_below(float y) { return int(std::ceil(y - 0.5f)); }
+
+  void add_edge(float xa, float ya, float xb, float yb) {
+    if (ya == yb)
+      return;
+    if (ya > yb) {
+      std::swap(xa, xb);
+      std::swap(ya, yb);
+    }
+    edges_.push_back({xa, ya, yb, (xb - xa) / (yb - ya)});
+  }
+
+  std::vector<edge> edges_;
+  std::vector<edge> active_;
+  std::vector<float> crossings_;
+};
+
+/**
+ * Draw a line or the outline of a ring, width pixels wide, anti-aliased by
+ * each pixel's distance to the segment. Joints are drawn by both segments,
+ * so translucent colors come out darker there.
+ */
+class line_drawer {
+public:
+  template <typename GeoData>
+  void draw(framebuffer &image, const map_view &view, const GeoData &path,
+            rgba color, float width) {
+    bool first = true;
+    float px = 0, py = 0;
+    for_each_point(path, [&](double mx, double my) {
+      const float x = float(view.x(mx)), y = float(view.y(my));
+      if (!first)
+        segment(image, px, py, x, y, color, width / 2);
+      first = false;
+      px = x;
+      py = y;
+    });
+  }
+
+  static void segment(framebuffer &image, float ax, float ay, float bx,
+                      float by, rgba color, float half_width) {
+    const float reach = half_width + 1;
+    const int x_min = std::max(0, int(std::floor(std::min(ax, bx) - reach)));
+    const int x_max = std::min(image.width(),
+                               int(std::ceil(std::max(ax, bx) + reach)));
+    const int y_min = std::max(0, int(std::floor(std::min(ay, by) - reach)));
+    const int y_max = std::min(image.height(),
+                               int(std::ceil(std::max(ay, by) + reach)));
+    if (x_min >= x_max || y_min >= y_max)
+      return;
+    const float dx = bx - ax, dy = by - ay;
+    const float length2 = dx * dx + dy * dy;
+    const float inverse = length2 > 0 ? 1 / length2 : 0;
+    const float alpha = float(color >> 24);
+
+    for (int y = y_min; y < y_max; ++y) {
+      rgba *row = image.row(y);
+      const float py = y + 0.5f - ay;
+      int x = x_min;
+#ifdef RASTERIZER_SSE2
+      const __m128 vdx = _mm_set1_ps(dx), vdy = _mm_set1_ps(dy);
+      const __m128 vpy = _mm_set1_ps(py), vinv = _mm_set1_ps(inverse);
+      const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1);
+      const __m128 edge = _mm_set1_ps(half_width + 0.5f);
+      const __m128 valpha = _mm_set1_ps(alpha);
+      for (; x + 4 <= x_max; x += 4) {
+        const __m128 px = _mm_add_ps(_mm_set1_ps(float(x) + 0.5f - ax),
+                                     _mm_set_ps(3, 2, 1, 0));
+        __m128 t = _mm_mul_ps(
+            _mm_add_ps(_mm_mul_ps(px, vdx), _mm_mul_ps(vpy, vdy)), vinv);
+        t = _mm_min_ps(_mm_max_ps(t, zero), one);
+        const __m128 ex = _mm_sub_ps(px, _mm_mul_ps(t, vdx));
+        const __m128 ey = _mm_sub_ps(vpy, _mm_mul_ps(t, vdy));
+        const __m128 distance =
+            _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)));
+        const __m128 coverage =
+            _mm_min_ps(_mm_max_ps(_mm_sub_ps(edge, distance), zero), one);
+        const __m128i a = _mm_cvtps_epi32(_mm_mul_ps(coverage, valpha));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(a, _mm_setzero_si128())) ==
+            0xffff)
+          continue;
+        // a0 a1 a2 a3 as 32-bit lanes, spread to 16-bit lanes per channel.
+        const __m128i a16 = _mm_packs_epi32(a, a);
+        const __m128i lo = _mm_unpacklo_epi16(a16, a16);
+        framebuffer::blend4(row + x, color,
+                            _mm_unpacklo_epi32(lo, lo),
+                            _mm_unpackhi_epi32(lo, lo));
+      }
+#endif
+      for (; x < x_max; ++x) {
+        const float px = x + 0.5f - ax;
+        const float t =
+            std::clamp((px * dx + py * dy) * inverse, 0.0f, 1.0f);
+        const float ex = px - t * dx, ey = py - t * dy;
+        const float coverage = std::clamp(
+            half_width + 0.5f - std::sqrt(ex * ex + ey * ey), 0.0f, 1.0f);
+        const unsigned a = unsigned(std::lround(coverage * alpha));
+        if (a > 0)
+          framebuffer::blend(row[x], color, a);
+      }
+    }
+  }
+};
+
+namespace png_detail {
+
+inline std::uint32_t crc32(const unsigned char *p, std::size_t n,
+                           std::uint32_t crc = 0) {
+  static const std::vector<std::uint32_t> table = [] {
+    std::vector<std::uint32_t> t(256);
+    for (std::uint32_t i = 0; i < 256; ++i) {
+      std::uint32_t c = i;
+      for (int k = 0; k < 8; ++k)
+        c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+      t[i] = c;
+    }
+    return t;
+  }();
+  crc = ~crc;
+  for (std::size_t i = 0; i < n; ++i)
+    crc = table[(crc ^ p[i]) & 255] ^ (crc >> 8);
+  return ~crc;
+}
+
+inline void put32(std::vector<unsigned char> &out, std::uint32_t v) {
+  for (int shift = 24; shift >= 0; shift -= 8)
+    out.push_back((v >> shift) & 255);
+}
+
+// Returns whether the whole chunk was written.
+inline bool chunk(std::FILE *file, const char *type,
+                  const std::vector<unsigned char> &data) {
+  std::vector<unsigned char> out;
+  put32(out, data.size());
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data.begin(), data.end());
+  put32(out, crc32(out.data() + 4, out.size() - 4));
+  return std::fwrite(out.data(), 1, out.size(), file) == out.size();
+}
+
+} // namespace png_detail
+
+inline void framebuffer::write_png(const std::string &path) const {
+  using namespace png_detail;
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> file(
+      std::fopen(path.c_str(), "wb"), std::fclose);
+  if (!file)
+    throw std::runtime_error("framebuffer: cannot create " + path);
+  static const unsigned char signature[8] = {0x89, 'P',  'N',  'G',
+                                             '\r', '\n', 0x1a, '\n'};
+  bool written = std::fwrite(signature, 1, sizeof(signature), file.get()) ==
+                 sizeof(signature);
+
+  std::vector<unsigned char> header;
+  put32(header, width_);
+  put32(header, height_);
+  header.insert(header.end(), {8, 6, 0, 0, 0}); // 8-bit RGBA
+  written = written && chunk(file.get(), "IHDR", header);
+
+  // Rows behind a filter byte of 0, in stored (uncompressed) deflate blocks.
+  std::vector<unsigned char> raw;
+  raw.reserve(std::size_t(height_) * (1 + 4 * width_));
+  for (int y = 0; y < height_; ++y) {
+    raw.push_back(0);
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(row(y));
+    raw.insert(raw.end(), p, p + 4 * width_);
+  }
+  std::vector<unsigned char> z = {0x78, 0x01};
+  std::size_t at = 0;
+  do {
+    const std::size_t n = std::min<std::size_t>(65535, raw.size() - at);
+    z.push_back(at + n == raw.size() ? 1 : 0); // the last block
+    z.push_back(n & 255);
+    z.push_back(n >> 8);
+    z.push_back(~n & 255);
+    z.push_back((~n >> 8) & 255);
+    z.insert(z.end(), raw.begin() + at, raw.begin() + at + n);
+    at += n;
+  } while (at < raw.size());
+  std::uint32_t a = 1, b = 0;
+  for (unsigned char c : raw) {
+    a = (a + c) % 65521;
+    b = (b + a) % 65521;
+  }
+  put32(z, b << 16 | a);
+  written = written && chunk(file.get(), "IDAT", z);
+  written = written && chunk(file.get(), "IEND", {});
+  // Buffered data is written by fclose, so it can fail as well.
+  if (std::fclose(file.release()) != 0 || !written)
+    throw std::runtime_error("framebuffer: cannot write " + path);
+}
+
+#endif /* end of include guard: RASTERIZER_H */
@@ -0,0 +1,448 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef SHM_SIGNAL_H
+#define SHM_SIGNAL_H
+
+#include "geo_codec.h"
+#include "signal.h"
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <tuple>
+#include <unistd.h>
+
+/**
+ * A byte ring in POSIX shared memory with one producer and up to
+ * max_subscribers consumers, each with its own read cursor. Records are
+ * variable length:
+ *      | size (incl. header) | type | points | x y x y ... |
+ * padded to 8 bytes; a record that would cross the end of the ring is
+ * preceded by a padding record that fills it.
+ *
+ * The producer never overwrites what an attached subscriber has not read;
+ * when the ring is full, it sleeps on a futex until a subscriber moves on,
+ * and subscribers sleep on another futex until data arrives. Every cursor
+ * records the pid of its process; a full producer detaches the cursors of
+ * processes that died attached, so a crashed subscriber does not hold it
+ * back.
+ */
+class shm_ring {
+public:
+  static constexpr std::uint32_t max_subscribers = 16;
+
+  struct record_header {
+    std::uint32_t size;
+    std::uint16_t type;
+    std::uint16_t reserved;
+    std::uint64_t points;
+  };
+
+  static constexpr std::uint16_t padding = 0;
+
+  /**
+   * Create (or replace) the ring named name, with capacity rounded up to a
+   * power of two.
+   */
+  static shm_ring create(const std::string &name, std::size_t capacity) {
+    std::size_t bytes = 4096;
+    while (bytes < capacity)
+      bytes <<= 1;
+    ::shm_unlink(name.c_str());
+    const int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+      throw std::runtime_error("shm_ring: cannot create " + name);
+    if (::ftruncate(fd, sizeof(header) + bytes) != 0) {
+      ::close(fd);
+      throw std::runtime_error("shm_ring: cannot size " + name);
+    }
+    shm_ring r(fd, sizeof(header) + bytes, name);
+    new (r.header_) header();
+    r.header_->capacity = bytes;
+    r.header_->magic.store(magic_value, std::memory_order_release);
+    return r;
+  }
+
+  /**
+   * Open a ring created by another process.
+   */
+  static shm_ring open(const std::string &name) {
+    const int fd = ::shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0)
+      throw std::runtime_error("shm_ring: cannot open " + name);
+    struct stat st;
+    ::fstat(fd, &st);
+    shm_ring r(fd, st.st_size, std::string());
+    if (r.header_->magic.load(std::memory_order_acquire) != magic_value)
+      throw std::runtime_error("shm_ring: not a ring: " + name);
+    return r;
+  }
+
+  shm_ring(shm_ring &&other) noexcept
+      : header_(other.header_), bytes_(other.bytes_),
+        owned_name_(std::move(other.owned_name_)) {
+    other.header_ = nullptr;
+  }
+
+  shm_ring(const shm_ring &) = delete;
+  shm_ring &operator=(const shm_ring &) = delete;
+
+  ~shm_ring() {
+    if (!header_)
+      return;
+    ::munmap(header_, bytes_);
+    if (!owned_name_.empty())
+      ::shm_unlink(owned_name_.c_str());
+  }
+
+  std::size_t capacity() const { return header_->capacity; }
+
+  /**
+   * Append a record, waiting for room if necessary. fill(xy) writes the
+   * coordinates straight into the ring.
+   */
+  template <typename Fill>
+  void publish(std::uint16_t type, std::size_t points, Fill &&fill) {
+    const std::size_t size =
+        padded(sizeof(record_header) + points * 2 * sizeof(double));
+    if (size > capacity() / 2)
+      throw std::length_error("shm_ring: record larger than half the ring");
+    header &h = *header_;
+    std::uint64_t head = h.head.load(std::memory_order_relaxed);
+    std::size_t offset = head & (capacity() - 1);
+    const std::size_t gap = offset + size > capacity() ? capacity() - offset
+                                                       : 0;
+    wait_for_space(head, gap + size);
+    if (gap) {
+      record_header pad{static_cast<std::uint32_t>(gap), padding, 0, 0};
+      std::memcpy(data() + offset, &pad, sizeof(pad));
+      offset = 0;
+    }
+    record_header r{static_cast<std::uint32_t>(size), type, 0, points};
+    std::memcpy(data() + offset, &r, sizeof(r));
+    fill(reinterpret_cast<double *>(data() + offset + sizeof(r)));
+    h.head.store(head + gap + size, std::memory_order_release);
+    h.data_seq.fetch_add(1, std::memory_order_seq_cst);
+    if (h.consumers_waiting.load(std::memory_order_seq_cst) > 0)
+      futex_wake(&h.data_seq);
+  }
+
+  /**
+   * Attach a subscriber; it receives records published from now on.
+   * Returns its cursor.
+   */
+  std::uint32_t attach() {
+    header &h = *header_;
+    for (std::uint32_t i = 0; i < max_subscribers; ++i) {
+      cursor_slot &c = h.cursors[i];
+      std::uint32_t idle = 0;
+      if (c.active.compare_exchange_strong(idle, 1)) {
+        c.pid.store(::getpid(), std::memory_order_relaxed);
+        c.tail.store(h.head.load(std::memory_order_acquire));
+        c.active.store(2, std::memory_order_seq_cst);
+        // The producer ignored the cursor while attaching and may have
+        // lapped that tail; from now on it holds back for the cursor.
+        c.tail.store(h.head.load(std::memory_order_seq_cst));
+        return i;
+      }
+    }
+    throw std::runtime_error("shm_ring: too many subscribers");
+  }
+
+  std::uint32_t subscribers() const {
+    std::uint32_t n = 0;
+    for (const cursor_slot &c : header_->cursors)
+      n += c.active.load(std::memory_order_acquire) == 2;
+    return n;
+  }
+
+  void detach(std::uint32_t cursor) {
+    header_->cursors[cursor].active.store(0, std::memory_order_release);
+    wake_producer();
+  }
+
+  /**
+   * Detach the cursors of processes that died attached. Returns how many.
+   */
+  std::uint32_t reap() {
+    std::uint32_t reaped = 0;
+    for (cursor_slot &c : header_->cursors) {
+      std::uint32_t attached = 2;
+      const pid_t pid = c.pid.load(std::memory_order_relaxed);
+      if (c.active.load(std::memory_order_acquire) == attached &&
+          !alive(pid) &&
+          c.active.compare_exchange_strong(attached, 0,
+                                           std::memory_order_acq_rel))
+        ++reaped;
+    }
+    return reaped;
+  }
+
+  /**
+   * Call f(geo_view) for every record available to cursor, then release
+   * them to the producer. Waits up to timeout_ns for the first if there is
+   * none (0: do not wait). Returns how many records were handled.
+   */
+  template <typename F>
+  std::size_t consume(std::uint32_t cursor, F &&f,
+                      std::int64_t timeout_ns = 0) {
+    header &h = *header_;
+    std::atomic<std::uint64_t> &tail_ref = h.cursors[cursor].tail;
+    std::uint64_t tail = tail_ref.load(std::memory_order_relaxed);
+    std::uint64_t head = h.head.load(std::memory_order_acquire);
+    if (tail == head && timeout_ns > 0) {
+      const std::uint32_t seq = h.data_seq.load(std::memory_order_acquire);
+      h.consumers_waiting.fetch_add(1, std::memory_order_seq_cst);
+      head = h.head.load(std::memory_order_seq_cst);
+      if (tail == head)
+        futex_wait(&h.data_seq, seq, timeout_ns);
+      h.consumers_waiting.fetch_sub(1, std::memory_order_relaxed);
+      head = h.head.load(std::memory_order_acquire);
+    }
+    std::size_t handled = 0;
+    while (tail != head) {
+      const char *at = data() + (tail & (capacity() - 1));
+      record_header r;
+      std::memcpy(&r, at, sizeof(r));
+      if (r.type != padding) {
+        f(geo_view{r.type,
+                   reinterpret_cast<const double *>(at + sizeof(r)),
+                   static_cast<std::size_t>(r.points)});
+        ++handled;
+      }
+      tail += r.size;
+    }
+    if (handled || tail != tail_ref.load(std::memory_order_relaxed)) {
+      tail_ref.store(tail, std::memory_order_release);
+      wake_producer();
+    }
+    return handled;
+  }
+
+private:
+  static constexpr std::uint64_t magic_value = 0x474e495241454f47ull;
+
+  struct cursor_slot {
+    alignas(64) std::atomic<std::uint64_t> tail{0};
+    std::atomic<std::uint32_t> active{0}; // 0 free, 1 attaching, 2 attached
+    std::atomic<pid_t> pid{0};            // of the subscriber's process
+  };
+
+  struct header {
+    std::atomic<std::uint64_t> magic{0};
+    std::uint64_t capacity = 0;
+    alignas(64) std::atomic<std::uint64_t> head{0};
+    std::atomic<std::uint32_t> data_seq{0};
+    std::atomic<std::uint32_t> consumers_waiting{0};
+    alignas(64) std::atomic<std::uint32_t> space_seq{0};
+    std::atomic<std::uint32_t> producer_waiting{0};
+    cursor_slot cursors[max_subscribers];
+  };
+
+  shm_ring(int fd, std::size_t bytes, std::string owned_name)
+      : bytes_(bytes), owned_name_(std::move(owned_name)) {
+    void *p =
+        ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED)
+      throw std::runtime_error("shm_ring: cannot map");
+    header_ = static_cast<header *>(p);
+  }
+
+  static std::size_t padded(std::size_t n) { return (n + 7) & ~std::size_t(7); }
+
+  char *data() { return reinterpret_cast<char *>(header_ + 1); }
+
+  // The oldest position an attached subscriber still needs.
+  std::uint64_t oldest_tail(std::uint64_t head) const {
+    std::uint64_t oldest = head;
+    for (const cursor_slot &c : header_->cursors) {
+      if (c.active.load(std::memory_order_acquire) == 2)
+        oldest = std::min(oldest, c.tail.load(std::memory_order_acquire));
+    }
+    return oldest;
+  }
+
+  static bool alive(pid_t pid) {
+    if (pid <= 0)
+      return true;
+    // A zombie, dead but not yet waited for, still answers kill(pid, 0).
+    char path[32];
+    std::snprintf(path, sizeof(path), "/proc/%d/stat", int(pid));
+    const int fd = ::open(path, O_RDONLY);
+    if (fd >= 0) {
+      char stat[256];
+      const ssize_t n = ::read(fd, stat, sizeof(stat) - 1);
+      ::close(fd);
+      if (n > 0) {
+        stat[n] = 0;
+        const char *name_end = std::strrchr(stat, ')');
+        return !name_end || name_end[1] != ' ' ||
+               (name_end[2] != 'Z' && name_end[2] != 'X');
+      }
+    }
+    // kill(pid, 0) as a raw system call: <signal.h> would clash with signal<>.
+    return ::syscall(SYS_kill, pid, 0) == 0 || errno != ESRCH;
+  }
+
+  void wait_for_space(std::uint64_t head, std::size_t bytes) {
+    header &h = *header_;
+    while (head + bytes - oldest_tail(head) > capacity()) {
+      if (reap() > 0)
+        continue;
+      const std::uint32_t seq = h.space_seq.load(std::memory_order_acquire);
+      h.producer_waiting.store(1, std::memory_order_seq_cst);
+      if (head + bytes - oldest_tail(head) > capacity())
+        futex_wait(&h.space_seq, seq, 1000000);
+      h.producer_waiting.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void wake_producer() {
+    header &h = *header_;
+    h.space_seq.fetch_add(1, std::memory_order_seq_cst);
+    if (h.producer_waiting.load(std::memory_order_seq_cst))
+      futex_wake(&h.space_seq);
+  }
+
+  // Shared (not process private) futexes, as the ring spans processes.
+  static void futex_wait(std::atomic<std::uint32_t> *word,
+                         std::uint32_t expected, std::int64_t timeout_ns) {
+    struct timespec t;
+    t.tv_sec = timeout_ns / 1000000000;
+    t.tv_nsec = timeout_ns % 1000000000;
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(word), FUTEX_WAIT,
+              expected, &t, nullptr, 0);
+  }
+
+  static void futex_wake(std::atomic<std::uint32_t> *word) {
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(word), FUTEX_WAKE,
+              INT_MAX, nullptr, nullptr, 0);
+  }
+
+  header *header_ = nullptr;
+  std::size_t bytes_ = 0;
+  std::string owned_name_; // unlinked on destruction by the creator
+};
+
+/**
+ * The sending end of a signal that crosses processes: emitting writes the
+ * geo data straight into the shared ring.
+ */
+class shm_signal_publisher {
+public:
+  explicit shm_signal_publisher(const std::string &name,
+                                std::size_t capacity = 1 << 22)
+      : ring_(shm_ring::create(name, capacity)) {}
+
+  /**
+   * Subscribers only receive what is emitted after they attached.
+   */
+  void wait_for_subscribers(std::uint32_t n) const {
+    while (ring_.subscribers() < n)
+      ::usleep(1000);
+  }
+
+  /**
+   * Wait until at most n subscribers are attached.
+   */
+  void wait_for_detach(std::uint32_t n = 0) {
+    while (ring_.subscribers() > n)
+      if (ring_.reap() == 0)
+        ::usleep(1000);
+  }
+
+  template <typename GeoData> void operator()(const GeoData &data) {
+    using codec = geo_codec<GeoData>;
+    ring_.publish(codec::type, codec::points(data),
+                  [&](double *xy) { codec::write(data, xy); });
+  }
+
+private:
+  shm_ring ring_;
+};
+
+/**
+ * The receiving end, in another process: local slots connect per type of
+ * geo data, as to a signal<>. Records are decoded into objects reused from
+ * call to call; connect_view slots read them in place instead.
+ */
+class shm_signal_subscriber {
+public:
+  explicit shm_signal_subscriber(const std::string &name)
+      : ring_(shm_ring::open(name)), cursor_(ring_.attach()) {}
+
+  shm_signal_subscriber(const shm_signal_subscriber &) = delete;
+  shm_signal_subscriber &operator=(const shm_signal_subscriber &) = delete;
+
+  ~shm_signal_subscriber() { ring_.detach(cursor_); }
+
+  /**
+   * The local signal for one type of geo data.
+   */
+  template <typename GeoData> signal<const GeoData &> &on() {
+    return std::get<typed<GeoData>>(typed_).slots;
+  }
+
+  int
+  connect_view(stdext::inplace_function<void(const geo_view &)> const &slot) {
+    return views_.connect(slot);
+  }
+
+  void disconnect_view(int id) { views_.disconnect(id); }
+
+  /**
+   * Deliver every record that arrived, waiting up to timeout_ns for one.
+   */
+  std::size_t poll(std::int64_t timeout_ns = 0) {
+    return ring_.consume(
+        cursor_,
+        [this](const geo_view &view) {
+          views_(view);
+          dispatch<point, line, ring>(view);
+        },
+        timeout_ns);
+  }
+
+private:
+  template <typename GeoData> struct typed {
+    signal<const GeoData &> slots;
+    GeoData scratch;
+  };
+
+  template <typename... GeoData> void dispatch(const geo_view &view) {
+    (void)((view.type == geo_codec<GeoData>::type
+                ? (decode<GeoData>(view), true)
+                : false) ||
+           ...);
+  }
+
+  template <typename GeoData> void decode(const geo_view &view) {
+    typed<GeoData> &t = std::get<typed<GeoData>>(typed_);
+    if (t.slots.empty())
+      return;
+    geo_codec<GeoData>::read(view.xy, view.points, t.scratch);
+    t.slots(t.scratch);
+  }
+
+  shm_ring ring_;
+  std::uint32_t cursor_;
+  signal<const geo_view &> views_;
+  std::tuple<typed<point>, typed<line>, typed<ring>> typed_;
+};
+
+#endif /* end of include guard: SHM_SIGNAL_H */
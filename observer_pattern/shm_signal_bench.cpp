@@ -0,0 +1,209 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "geometry.h"
+#include "shm_signal.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * Rings from one process to another, over the shared memory signal and over
+ * a Unix domain socket carrying the same records: throughput of a stream of
+ * five point rings, and the round trip latency of one ring.
+ *
+ *      g++ -std=c++17 -O2 shm_signal_bench.cpp -lrt
+ */
+using clock_type = std::chrono::steady_clock;
+
+static const int rings = 1000000;
+static const int round_trips = 100000;
+
+static ring field() {
+  point a{0.0, 0.0};
+  point b{0.0, 5.0};
+  point c{5.0, 5.0};
+  point d{5.0, 0.0};
+  return ring{a, b, c, d, a};
+}
+
+static void write_all(int fd, const char *p, std::size_t n) {
+  while (n > 0) {
+    const ssize_t w = ::write(fd, p, n);
+    if (w <= 0)
+      throw std::runtime_error("write failed");
+    p += w;
+    n -= w;
+  }
+}
+
+static void read_all(int fd, char *p, std::size_t n) {
+  while (n > 0) {
+    const ssize_t r = ::read(fd, p, n);
+    if (r <= 0)
+      throw std::runtime_error("read failed");
+    p += r;
+    n -= r;
+  }
+}
+
+// The record of the ring, as a socket carries it.
+static std::vector<char> encode(const ring &r) {
+  shm_ring::record_header h{0, geo_codec<ring>::type, 0, r.size()};
+  std::vector<char> bytes(sizeof(h) + r.size() * 2 * sizeof(double));
+  h.size = static_cast<std::uint32_t>(bytes.size());
+  std::memcpy(bytes.data(), &h, sizeof(h));
+  geo_codec<ring>::write(r, reinterpret_cast<double *>(&bytes[sizeof(h)]));
+  return bytes;
+}
+
+static double shm_throughput() {
+  const std::string name = "/shm_signal_bench";
+  shm_signal_publisher publisher(name);
+  if (::fork() == 0) {
+    {
+      shm_signal_subscriber subscriber(name);
+      int received = 0;
+      subscriber.on<ring>().connect([&](const ring &) { ++received; });
+      while (received < rings)
+        subscriber.poll(1000000);
+    }
+    std::exit(0);
+  }
+  const ring r = field();
+  publisher.wait_for_subscribers(1);
+  const auto start = clock_type::now();
+  for (int i = 0; i < rings; ++i)
+    publisher(r);
+  publisher.wait_for_detach();
+  std::chrono::duration<double> d = clock_type::now() - start;
+  return rings / d.count();
+}
+
+static double socket_throughput() {
+  int fds[2];
+  ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+  if (::fork() == 0) {
+    ::close(fds[0]);
+    // Read in large chunks and decode every record, as a subscriber would.
+    std::vector<char> buffer(1 << 16);
+    std::size_t filled = 0;
+    int received = 0;
+    ring decoded;
+    while (received < rings) {
+      const ssize_t n =
+          ::read(fds[1], buffer.data() + filled, buffer.size() - filled);
+      if (n <= 0)
+        break;
+      filled += n;
+      std::size_t at = 0;
+      shm_ring::record_header h;
+      while (filled - at >= sizeof(h)) {
+        std::memcpy(&h, &buffer[at], sizeof(h));
+        if (filled - at < h.size)
+          break;
+        geo_codec<ring>::read(
+            reinterpret_cast<const double *>(&buffer[at + sizeof(h)]),
+            h.points, decoded);
+        ++received;
+        at += h.size;
+      }
+      std::memmove(buffer.data(), buffer.data() + at, filled - at);
+      filled -= at;
+    }
+    write_all(fds[1], "k", 1);
+    std::exit(0);
+  }
+  ::close(fds[1]);
+  const ring r = field();
+  const auto start = clock_type::now();
+  for (int i = 0; i < rings; ++i) {
+    // Serialized per emit, as with the shared memory signal.
+    const std::vector<char> bytes = encode(r);
+    write_all(fds[0], bytes.data(), bytes.size());
+  }
+  char ack;
+  read_all(fds[0], &ack, 1);
+  std::chrono::duration<double> d = clock_type::now() - start;
+  ::close(fds[0]);
+  return rings / d.count();
+}
+
+static double shm_round_trip() {
+  shm_ring ping = shm_ring::create("/shm_signal_bench_ping", 1 << 16);
+  shm_ring pong = shm_ring::create("/shm_signal_bench_pong", 1 << 16);
+  const std::uint32_t cursor = pong.attach();
+  if (::fork() == 0) {
+    shm_ring in = shm_ring::open("/shm_signal_bench_ping");
+    shm_ring out = shm_ring::open("/shm_signal_bench_pong");
+    const std::uint32_t c = in.attach();
+    for (int i = 0; i < round_trips;) {
+      in.consume(
+          c,
+          [&](const geo_view &v) {
+            out.publish(v.type, v.points, [&](double *xy) {
+              std::memcpy(xy, v.xy, v.points * 2 * sizeof(double));
+            });
+            ++i;
+          },
+          1000000000);
+    }
+    in.detach(c);
+    std::exit(0);
+  }
+  while (ping.subscribers() < 1)
+    ::usleep(1000);
+  const ring r = field();
+  const auto start = clock_type::now();
+  for (int i = 0; i < round_trips; ++i) {
+    ping.publish(geo_codec<ring>::type, r.size(),
+                 [&](double *xy) { geo_codec<ring>::write(r, xy); });
+    while (pong.consume(cursor, [](const geo_view &) {}, 1000000000) == 0) {
+    }
+  }
+  std::chrono::duration<double, std::micro> d = clock_type::now() - start;
+  pong.detach(cursor);
+  return d.count() / round_trips;
+}
+
+static double socket_round_trip() {
+  int fds[2];
+  ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+  const std::vector<char> bytes = encode(field());
+  if (::fork() == 0) {
+    ::close(fds[0]);
+    std::vector<char> echo(bytes.size());
+    for (int i = 0; i < round_trips; ++i) {
+      read_all(fds[1], echo.data(), echo.size());
+      write_all(fds[1], echo.data(), echo.size());
+    }
+    std::exit(0);
+  }
+  ::close(fds[1]);
+  std::vector<char> reply(bytes.size());
+  const auto start = clock_type::now();
+  for (int i = 0; i < round_trips; ++i) {
+    write_all(fds[0], bytes.data(), bytes.size());
+    read_all(fds[0], reply.data(), reply.size());
+  }
+  std::chrono::duration<double, std::micro> d = clock_type::now() - start;
+  ::close(fds[0]);
+  return d.count() / round_trips;
+}
+
+int main() {
+  // Measured before printing, so forked children inherit no pending output.
+  const double shm_rate = shm_throughput();
+  const double shm_latency = shm_round_trip();
+  const double socket_rate = socket_throughput();
+  const double socket_latency = socket_round_trip();
+  std::cout << "shared memory: " << shm_rate << " rings/s, " << shm_latency
+            << " us/round trip\n";
+  std::cout << "unix socket:   " << socket_rate << " rings/s, "
+            << socket_latency << " us/round trip\n";
+  return 0;
+}
@@ -5,7 +5,7 @@
 #ifndef SIGNAL_HPP
 #define SIGNAL_HPP
 
-#include "inplace_function.h"
+#include "../common/inplace_function.h"
 #include <boost/container/flat_map.hpp>
 
 /**
@@ -31,6 +31,11 @@ public:
    */
   void disconnect_all() const { slots_.clear(); }
 
+  /**
+   * Whether no slot is connected.
+   */
+  bool empty() const { return slots_.empty(); }
+
   /**
    * Notify all observers.
    */
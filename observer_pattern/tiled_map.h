@@ -0,0 +1,244 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef TILED_MAP_H
+#define TILED_MAP_H
+
+#include "../common/worker_pool.h"
+#include "quantized_geometry.h"
+#include "rasterizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * How a shape is drawn: filled, outlined, or both. A color with alpha 0 is
+ * not drawn.
+ */
+struct map_style {
+  rgba fill = 0;
+  rgba stroke = 0;
+  float width = 2; // of the outline, in pixels
+};
+
+/**
+ * A map that keeps its shapes and renders them tile by tile. Every shape is
+ * binned to the tiles its bounding box overlaps; render() redraws only the
+ * tiles that shapes were added to, changed in or removed from, in parallel.
+ * All other tiles keep their pixels.
+ *
+ * Shapes are drawn in the order they were added. A tile that only gained
+ * shapes draws just those over its pixels; a tile that lost or changed one
+ * is drawn again from its background.
+ */
+template <typename GeoData> class tiled_map {
+public:
+  using shape_id = std::size_t;
+
+  /**
+   * A width x height map through view, whose height is set to the map's.
+   */
+  tiled_map(int width, int height, map_view view,
+            rgba background = make_rgba(255, 255, 255), int tile_size = 64,
+            unsigned threads = std::max(1u, std::thread::hardware_concurrency()))
+      : image_(width, height, background), view_(view),
+        background_(background), tile_size_(tile_size),
+        columns_((width + tile_size - 1) / tile_size),
+        rows_((height + tile_size - 1) / tile_size),
+        tiles_(std::size_t(columns_) * rows_), pool_(threads) {
+    view_.height = height;
+    for (unsigned i = 0; i < pool_.threads(); ++i)
+      scratch_.emplace_back(tile_size);
+  }
+
+  const framebuffer &image() const { return image_; }
+  const map_view &view() const { return view_; }
+  int tile_size() const { return tile_size_; }
+  std::size_t tiles() const { return tiles_.size(); }
+
+  /**
+   * Add a shape on top of all others.
+   */
+  shape_id add(GeoData data, const map_style &style) {
+    const shape_id id = shapes_.size();
+    shapes_.push_back({std::move(data), style, {}});
+    shape &s = shapes_.back();
+    s.tiles = tiles_of(s);
+    for_each_tile(s.tiles, [&](std::size_t t) {
+      tiles_[t].shapes.push_back(id); // ids only grow: still in order
+      touch(t, false);
+    });
+    return id;
+  }
+
+  /**
+   * Replace the geo data of a shape, keeping its style and its place.
+   */
+  void update(shape_id id, GeoData data) {
+    shape &s = shapes_[id];
+    unbin(id);
+    s.data = std::move(data);
+    s.tiles = tiles_of(s);
+    for_each_tile(s.tiles, [&](std::size_t t) {
+      std::vector<shape_id> &bin = tiles_[t].shapes;
+      bin.insert(std::lower_bound(bin.begin(), bin.end(), id), id);
+      touch(t, true);
+    });
+  }
+
+  void remove(shape_id id) {
+    unbin(id);
+    shapes_[id].data = GeoData();
+  }
+
+  /**
+   * Redraw the tiles that changed since the last render, and return how many
+   * there were.
+   */
+  std::size_t render() {
+    pool_.run(dirty_.size(),
+              [&](std::size_t i, unsigned thread) { draw(dirty_[i], thread); });
+    const std::size_t drawn = dirty_.size();
+    for (std::size_t t : dirty_) {
+      tiles_[t].queued = false;
+      tiles_[t].redraw = false;
+      tiles_[t].drawn = tiles_[t].shapes.size();
+    }
+    dirty_.clear();
+    return drawn;
+  }
+
+private:
+  struct tile_range {
+    int c0 = 0, r0 = 0, c1 = 0, r1 = 0; // [c0, c1) x [r0, r1)
+  };
+
+  struct shape {
+    GeoData data;
+    map_style style;
+    tile_range tiles;
+  };
+
+  struct tile {
+    std::vector<shape_id> shapes; // in drawing order
+    std::size_t drawn = 0;        // shapes already in the pixels
+    bool redraw = false;          // from the background
+    bool queued = false;
+  };
+
+  struct scratch {
+    explicit scratch(int tile_size) : pixels(tile_size, tile_size) {}
+
+    framebuffer pixels;
+    polygon_filler filler;
+    line_drawer drawer;
+  };
+
+  tile_range tiles_of(const shape &s) const {
+    double x0 = 0, y0 = 0, x1 = -1, y1 = -1;
+    bool first = true;
+    for_each_point(s.data, [&](double mx, double my) {
+      const double x = view_.x(mx), y = view_.y(my);
+      if (first) {
+        x0 = x1 = x;
+        y0 = y1 = y;
+        first = false;
+      }
+      x0 = std::min(x0, x);
+      x1 = std::max(x1, x);
+      y0 = std::min(y0, y);
+      y1 = std::max(y1, y);
+    });
+    if (first)
+      return {};
+    // The reach of the anti-aliased outline, or a pixel of rounding.
+    const double reach =
+        (s.style.stroke >> 24 ? s.style.width / 2.0 : 0.0) + 1;
+    auto column = [&](double x) {
+      return std::clamp(int(std::floor(x / tile_size_)), -1, columns_);
+    };
+    auto row = [&](double y) {
+      return std::clamp(int(std::floor(y / tile_size_)), -1, rows_);
+    };
+    return {std::max(column(x0 - reach), 0), std::max(row(y0 - reach), 0),
+            std::min(column(x1 + reach) + 1, columns_),
+            std::min(row(y1 + reach) + 1, rows_)};
+  }
+
+  template <typename F> void for_each_tile(const tile_range &r, F &&f) {
+    for (int row = r.r0; row < r.r1; ++row)
+      for (int column = r.c0; column < r.c1; ++column)
+        f(std::size_t(row) * columns_ + column);
+  }
+
+  void unbin(shape_id id) {
+    for_each_tile(shapes_[id].tiles, [&](std::size_t t) {
+      std::vector<shape_id> &bin = tiles_[t].shapes;
+      bin.erase(std::lower_bound(bin.begin(), bin.end(), id));
+      touch(t, true);
+    });
+    shapes_[id].tiles = {};
+  }
+
+  void touch(std::size_t t, bool redraw) {
+    tile &tile = tiles_[t];
+    tile.redraw = tile.redraw || redraw;
+    if (!tile.queued) {
+      tile.queued = true;
+      dirty_.push_back(t);
+    }
+  }
+
+  /**
+   * Draw a tile in the thread's scratch tile, and copy it into the map.
+   */
+  void draw(std::size_t t, unsigned thread) {
+    const tile &tile = tiles_[t];
+    scratch &s = scratch_[thread];
+    const int column = int(t % columns_), row = int(t / columns_);
+    const int x = column * tile_size_, y = row * tile_size_;
+    const int width = std::min(tile_size_, image_.width() - x);
+    const int height = std::min(tile_size_, image_.height() - y);
+    const std::size_t bytes = std::size_t(width) * sizeof(rgba);
+
+    std::size_t first = tile.drawn;
+    if (tile.redraw) {
+      s.pixels.clear(background_);
+      first = 0;
+    } else {
+      for (int i = 0; i < height; ++i)
+        std::memcpy(s.pixels.row(i), image_.row(y + i) + x, bytes);
+    }
+    const map_view view{view_.x0 + x * view_.units_per_pixel, view_.y0,
+                        view_.units_per_pixel, view_.height - y};
+    for (std::size_t i = first; i < tile.shapes.size(); ++i) {
+      const shape &shape = shapes_[tile.shapes[i]];
+      if (shape.style.fill >> 24)
+        s.filler.fill(s.pixels, view, shape.data, shape.style.fill);
+      if (shape.style.stroke >> 24)
+        s.drawer.draw(s.pixels, view, shape.data, shape.style.stroke,
+                      shape.style.width);
+    }
+    for (int i = 0; i < height; ++i)
+      std::memcpy(image_.row(y + i) + x, s.pixels.row(i), bytes);
+  }
+
+  framebuffer image_;
+  map_view view_;
+  rgba background_;
+  int tile_size_;
+  int columns_;
+  int rows_;
+  std::vector<shape> shapes_; // by id
+  std::vector<tile> tiles_;   // rows top to bottom
+  std::vector<std::size_t> dirty_;
+  worker_pool pool_;
+  std::vector<scratch> scratch_; // one per thread
+};
+
+#endif /* end of include guard: TILED_MAP_H */
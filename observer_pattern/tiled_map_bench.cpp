@@ -0,0 +1,119 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "geometry.h"
+#include "tiled_map.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/**
+ * A 2048 x 2048 map of 20000 outlined fields in 64 x 64 tiles: the first
+ * frame, against drawing every field into one framebuffer, and frames after
+ * adding one field, moving one field, and moving a field 10 times as large.
+ */
+using clock_type = std::chrono::steady_clock;
+
+template <typename F> static double milliseconds(F &&f) {
+  const auto start = clock_type::now();
+  f();
+  return std::chrono::duration<double, std::milli>(clock_type::now() - start)
+      .count();
+}
+
+static ring make_field(std::mt19937 &random, double cx, double cy,
+                       double radius) {
+  std::uniform_int_distribution<int> points(32, 256);
+  std::uniform_real_distribution<double> wobble(-0.05, 0.05);
+  const double pi = std::acos(-1.0);
+  const int n = points(random);
+  ring field;
+  for (int k = n - 1; k >= 0; --k) {
+    const double angle = 2 * pi * k / n, r = radius * (1 + wobble(random));
+    field.push_back(point{cx + r * std::cos(angle), cy + r * std::sin(angle)});
+  }
+  field.push_back(field.front());
+  return field;
+}
+
+int main() {
+  std::mt19937 random(42);
+  std::uniform_real_distribution<double> where(0.0, 2048.0);
+  std::vector<ring> fields;
+  for (int i = 0; i < 20000; ++i)
+    fields.push_back(make_field(random, where(random), where(random), 20));
+
+  const map_view view{0.0, 0.0, 1.0, 2048};
+  const map_style style{make_rgba(110, 170, 60, 160), make_rgba(40, 40, 40),
+                        2};
+
+  framebuffer direct(2048, 2048, make_rgba(255, 255, 255));
+  polygon_filler filler;
+  line_drawer drawer;
+  const double whole = milliseconds([&] {
+    for (const ring &field : fields) {
+      filler.fill(direct, view, field, style.fill);
+      drawer.draw(direct, view, field, style.stroke, style.width);
+    }
+  });
+  std::cout << "one framebuffer: " << whole << " ms\n";
+
+  for (unsigned threads : {1u, 4u}) {
+    tiled_map<ring> map(2048, 2048, view, make_rgba(255, 255, 255), 64,
+                        threads);
+    for (const ring &field : fields)
+      map.add(field, style);
+    std::size_t tiles = 0;
+    const double first = milliseconds([&] { tiles = map.render(); });
+    std::cout << threads << " thread(s): first frame " << first << " ms, "
+              << tiles << " tiles\n";
+    if (threads > 1)
+      continue;
+
+    // Tiles draw in their own frame; rounding may move an edge pixel.
+    std::size_t differ = 0;
+    int most = 0;
+    for (int y = 0; y < 2048; ++y)
+      for (int x = 0; x < 2048; ++x) {
+        const rgba a = map.image().pixel(x, y), b = direct.pixel(x, y);
+        if (a == b)
+          continue;
+        ++differ;
+        for (int shift = 0; shift < 32; shift += 8)
+          most = std::max(most, std::abs(int(a >> shift & 255) -
+                                         int(b >> shift & 255)));
+      }
+    std::cout << "pixels unlike one framebuffer: " << differ
+              << ", by at most " << most << "\n";
+
+    const int frames = 100;
+    tiles = 0;
+    const double added = milliseconds([&] {
+      for (int i = 0; i < frames; ++i) {
+        map.add(make_field(random, where(random), where(random), 20), style);
+        tiles += map.render();
+      }
+    });
+    std::cout << "add a field: " << added / frames << " ms, "
+              << double(tiles) / frames << " tiles per frame\n";
+
+    for (double radius : {20.0, 200.0}) {
+      tiles = 0;
+      const double moved = milliseconds([&] {
+        for (int i = 0; i < frames; ++i) {
+          map.update(i, make_field(random, where(random), where(random),
+                                   radius));
+          tiles += map.render();
+        }
+      });
+      std::cout << "move a field of radius " << radius << ": "
+                << moved / frames << " ms, " << double(tiles) / frames
+                << " tiles per frame\n";
+    }
+  }
+  return 0;
+}
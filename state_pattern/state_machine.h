@@ -0,0 +1,211 @@
+#ifndef STATE_MACHINE_H
+#define STATE_MACHINE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+/*
+ * A state machine whose transitions are fixed at compile time.
+ *
+ * States and events are plain types. Every transition names the state it
+ * leaves, the event that triggers it and the state it enters, and optionally
+ * a guard and an action:
+ *
+ *      bool guard(Context &, const Event &);
+ *      void action(Context &, const Event &);
+ *
+ * For every event type, the transitions are compiled into a constexpr column
+ * with one row per state, so handling an event is an array lookup--no
+ * visiting, no allocation. The machine itself only defines behaviour; an
+ * instance is a StateId, which lets instances live wherever suits the
+ * caller.
+ *
+ * If the context has onEnter(State) or onExit(State) members, they are
+ * called on every change of state. A transition from a state to itself
+ * calls neither.
+ *
+ * A state may declare a static timeout member. Entering it then calls
+ * context.armTimeout(State::timeout) and leaving it context.cancelTimeout(),
+ * so the timer never outlives the state. Dispatching Timeout when the timer
+ * expires is up to the context.
+ */
+
+template <class... S> struct States {
+  static constexpr std::size_t size = sizeof...(S);
+};
+
+/* The event for the timeout of the current state. */
+struct Timeout {};
+
+/* Matches every state that has no transition of its own for the event. */
+struct AnyState {};
+
+template <class From, class Event, class To, auto Guard = nullptr,
+          auto Action = nullptr>
+struct Transition {
+  using from = From;
+  using event = Event;
+  using to = To;
+  static constexpr auto guard = Guard;
+  static constexpr auto action = Action;
+};
+
+template <class Context, class StateList, class... Transitions>
+class StateMachine;
+
+template <class Context, class... S, class... Transitions>
+class StateMachine<Context, States<S...>, Transitions...> {
+  static_assert(sizeof...(S) > 0 && sizeof...(S) < 256,
+                "a state machine has between 1 and 255 states");
+
+public:
+  using StateId = std::uint8_t;
+
+  static constexpr std::size_t size = sizeof...(S);
+
+  /* The first state is the initial one. */
+  static constexpr StateId initial = 0;
+
+  template <class X> static constexpr StateId id() {
+    constexpr bool matches[] = {std::is_same_v<X, S>...};
+    for (std::size_t i = 0; i < size; ++i) {
+      if (matches[i])
+        return static_cast<StateId>(i);
+    }
+    throw "not a state of this machine";
+  }
+
+  template <class E> struct Row {
+    bool valid = false;
+    StateId to = 0;
+    bool (*guard)(Context &, const E &) = nullptr;
+    void (*action)(Context &, const E &) = nullptr;
+  };
+
+  template <class E> using Column = std::array<Row<E>, size>;
+
+  /*
+   * All transitions triggered by E, by state they leave.
+   */
+  template <class E> static const Column<E> &column() {
+    static constexpr Column<E> c = makeColumn<E>();
+    return c;
+  }
+
+  /*
+   * Enter the initial state.
+   */
+  static StateId start(Context &context) {
+    enter(initial, context);
+    return initial;
+  }
+
+  /*
+   * Handle an event. Returns false, leaving state unchanged, if the current
+   * state has no transition for it or its guard refuses.
+   */
+  template <class E>
+  static bool dispatch(StateId &state, Context &context, const E &event) {
+    const Row<E> &row = column<E>()[state];
+    if (!row.valid || (row.guard && !row.guard(context, event)))
+      return false;
+    if (row.to != state)
+      exit(state, context);
+    if (row.action)
+      row.action(context, event);
+    if (row.to != state) {
+      state = row.to;
+      enter(state, context);
+    }
+    return true;
+  }
+
+  template <class X> static bool is(StateId state) { return state == id<X>(); }
+
+  /*
+   * Call f(X{}) with the type of the given state.
+   */
+  template <class F> static void visit(StateId state, F &&f) {
+    std::size_t i = 0;
+    ((i++ == state ? (void)f(S{}) : (void)0), ...);
+  }
+
+  static void enter(StateId state, Context &context) {
+    visit(state, [&](auto s) {
+      if constexpr (hasOnEnter<decltype(s)>(0))
+        context.onEnter(s);
+      if constexpr (hasTimeout<decltype(s)>(0))
+        context.armTimeout(decltype(s)::timeout);
+    });
+  }
+
+  static void exit(StateId state, Context &context) {
+    visit(state, [&](auto s) {
+      if constexpr (hasTimeout<decltype(s)>(0))
+        context.cancelTimeout();
+      if constexpr (hasOnExit<decltype(s)>(0))
+        context.onExit(s);
+    });
+  }
+
+private:
+  template <class X>
+  static constexpr auto hasTimeout(int) -> decltype(X::timeout, true) {
+    return true;
+  }
+  template <class X> static constexpr bool hasTimeout(...) { return false; }
+
+  template <class X, class C = Context>
+  static constexpr auto hasOnEnter(int)
+      -> decltype(std::declval<C &>().onEnter(X{}), true) {
+    return true;
+  }
+  template <class X> static constexpr bool hasOnEnter(...) { return false; }
+
+  template <class X, class C = Context>
+  static constexpr auto hasOnExit(int)
+      -> decltype(std::declval<C &>().onExit(X{}), true) {
+    return true;
+  }
+  template <class X> static constexpr bool hasOnExit(...) { return false; }
+
+  template <class E, class T> static constexpr Row<E> makeRow() {
+    Row<E> row;
+    row.valid = true;
+    row.to = id<typename T::to>();
+    if constexpr (!std::is_null_pointer_v<decltype(T::guard)>)
+      row.guard = T::guard;
+    if constexpr (!std::is_null_pointer_v<decltype(T::action)>)
+      row.action = T::action;
+    return row;
+  }
+
+  template <class E> static constexpr Column<E> makeColumn() {
+    Column<E> c{};
+    (addTransition<E, Transitions, false>(c), ...);
+    (addTransition<E, Transitions, true>(c), ...);
+    return c;
+  }
+
+  // Transitions from AnyState go second, so they only fill gaps.
+  template <class E, class T, bool any>
+  static constexpr void addTransition(Column<E> &c) {
+    if constexpr (std::is_same_v<typename T::event, E>) {
+      if constexpr (std::is_same_v<typename T::from, AnyState>) {
+        if (any) {
+          for (std::size_t i = 0; i < size; ++i) {
+            if (!c[i].valid)
+              c[i] = makeRow<E, T>();
+          }
+        }
+      } else if (!any) {
+        c[id<typename T::from>()] = makeRow<E, T>();
+      }
+    }
+  }
+};
+
+#endif /* end of include guard: STATE_MACHINE_H */
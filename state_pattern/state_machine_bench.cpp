@@ -0,0 +1,132 @@
+#include "state_machine.h"
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <variant>
+#include <vector>
+
+/*
+ * Events per second through 10000 connection state machines: the table
+ * driven StateMachine against a std::variant with std::visit transitions.
+ * Build with
+ *
+ *      g++ -std=c++17 -O2 state_machine_bench.cpp
+ */
+
+struct Disconnected {};
+struct Connecting {};
+struct Connected {};
+
+struct Connect {};
+struct Established {};
+struct Interrupt {};
+
+struct Device {
+  std::uint32_t attempts = 0;
+  std::uint32_t changes = 0;
+
+  template <class S> void onExit(S) { ++changes; }
+};
+
+static bool mayRetry(Device &d, const Connect &) { return d.attempts < 1000; }
+static void countAttempt(Device &d, const Connect &) { ++d.attempts; }
+static void resetAttempts(Device &d, const Established &) { d.attempts = 0; }
+
+using Machine = StateMachine<
+    Device, States<Disconnected, Connecting, Connected>,
+    Transition<Disconnected, Connect, Connecting, mayRetry, countAttempt>,
+    Transition<Connecting, Established, Connected, nullptr, resetAttempts>,
+    Transition<AnyState, Interrupt, Disconnected>>;
+
+template <class... Ts> struct overloaded : Ts... { using Ts::operator()...; };
+template <class... Ts> overloaded(Ts...) -> overloaded<Ts...>;
+
+using State = std::variant<Disconnected, Connecting, Connected>;
+
+static void visitDispatch(State &state, Device &d, int event) {
+  State next = std::visit(
+      overloaded{
+          [&](Disconnected) -> State {
+            if (event == 0 && d.attempts < 1000) {
+              ++d.attempts;
+              return Connecting();
+            }
+            return Disconnected();
+          },
+          [&](Connecting) -> State {
+            if (event == 1) {
+              d.attempts = 0;
+              return Connected();
+            }
+            return event == 2 ? State(Disconnected()) : State(Connecting());
+          },
+          [&](Connected) -> State {
+            return event == 2 ? State(Disconnected()) : State(Connected());
+          },
+      },
+      state);
+  if (next.index() != state.index())
+    ++d.changes;
+  state = next;
+}
+
+int main() {
+  const std::size_t machines = 10000, events = 50000000;
+
+  // A fixed pseudo random stream of (machine, event) pairs.
+  std::vector<std::uint32_t> stream(1 << 20);
+  std::uint32_t x = 2463534242u;
+  for (auto &e : stream) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    e = x;
+  }
+
+  std::vector<Device> devices(machines);
+  std::vector<Machine::StateId> states(machines);
+  for (std::size_t i = 0; i < machines; ++i)
+    states[i] = Machine::start(devices[i]);
+
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < events; ++i) {
+    const std::uint32_t e = stream[i & (stream.size() - 1)];
+    const std::size_t m = e % machines;
+    switch (e >> 30) {
+    case 0:
+    case 1:
+      Machine::dispatch(states[m], devices[m], Connect{});
+      break;
+    case 2:
+      Machine::dispatch(states[m], devices[m], Established{});
+      break;
+    default:
+      Machine::dispatch(states[m], devices[m], Interrupt{});
+    }
+  }
+  std::chrono::duration<double> table =
+      std::chrono::steady_clock::now() - start;
+
+  std::vector<Device> visited(machines);
+  std::vector<State> variants(machines);
+  start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < events; ++i) {
+    const std::uint32_t e = stream[i & (stream.size() - 1)];
+    const std::size_t m = e % machines;
+    const int event = (e >> 30) < 2 ? 0 : (e >> 30) == 2 ? 1 : 2;
+    visitDispatch(variants[m], visited[m], event);
+  }
+  std::chrono::duration<double> visit =
+      std::chrono::steady_clock::now() - start;
+
+  std::uint64_t changes = 0, visitChanges = 0;
+  for (std::size_t i = 0; i < machines; ++i) {
+    changes += devices[i].changes;
+    visitChanges += visited[i].changes;
+  }
+  std::cout << "table:   " << events / table.count() << " events/s ("
+            << changes << " changes)\n"
+            << "variant: " << events / visit.count() << " events/s ("
+            << visitChanges << " changes)\n";
+  return 0;
+}
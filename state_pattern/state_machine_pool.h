@@ -0,0 +1,201 @@
+#ifndef STATE_MACHINE_POOL_H
+#define STATE_MACHINE_POOL_H
+
+#include "../common/worker_pool.h"
+#include "state_machine.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+ * Many instances of one StateMachine, stored by column: all state ids in one
+ * contiguous array, all contexts in another, and for every state with data
+ * a column of its payload. A payload is reset to S{} whenever its instance
+ * enters S.
+ *
+ * dispatch() of one event to a batch of instances first groups the batch by
+ * current state, then runs each group in a loop where the transition, the
+ * guard and the hooks are the same for every instance.
+ */
+template <class Machine> class StateMachinePool;
+
+template <class Context, class... S, class... Transitions>
+class StateMachinePool<StateMachine<Context, States<S...>, Transitions...>> {
+public:
+  using Machine = StateMachine<Context, States<S...>, Transitions...>;
+  using StateId = typename Machine::StateId;
+  using InstanceId = std::uint32_t;
+
+  /*
+   * Add an instance in the initial state.
+   */
+  InstanceId create(Context context = {}) {
+    const InstanceId id = static_cast<InstanceId>(m_states.size());
+    m_contexts.push_back(std::move(context));
+    m_states.push_back(Machine::initial);
+    std::apply([](auto &... column) { (column.emplace_back(), ...); },
+               m_payloads);
+    enter(id, Machine::initial);
+    return id;
+  }
+
+  std::size_t size() const { return m_states.size(); }
+
+  StateId state(InstanceId id) const { return m_states[id]; }
+  Context &context(InstanceId id) { return m_contexts[id]; }
+
+  /*
+   * The data of an instance for state X; only meaningful while in X.
+   */
+  template <class X> X &payload(InstanceId id) {
+    return std::get<Payloads<X>>(m_payloads)[id];
+  }
+
+  template <class X> std::size_t count() const {
+    return std::count(m_states.begin(), m_states.end(),
+                      Machine::template id<X>());
+  }
+
+  template <class E> bool dispatch(const E &event, InstanceId id) {
+    const auto &row = Machine::template column<E>()[m_states[id]];
+    return row.valid && fire(row, event, id);
+  }
+
+  /*
+   * Handle one event for every instance in ids, which must be distinct.
+   * Returns how many of them changed state or ran an action.
+   */
+  template <class E>
+  std::size_t dispatch(const E &event, const InstanceId *ids, std::size_t n) {
+    thread_local Groups groups;
+    groups.sort(m_states, ids, n);
+    std::size_t fired = 0;
+    for (std::size_t s = 0; s < Machine::size; ++s) {
+      const auto &row = Machine::template column<E>()[s];
+      if (!row.valid)
+        continue;
+      for (InstanceId id : groups.of(s))
+        fired += fire(row, event, id);
+    }
+    return fired;
+  }
+
+  template <class E>
+  std::size_t dispatch(const E &event, const std::vector<InstanceId> &ids) {
+    return dispatch(event, ids.data(), ids.size());
+  }
+
+  /*
+   * The same, with ids split in slices over several threads. Instances are
+   * never shared between slices, so the threads do not synchronize. The
+   * threads are started by the first such call and kept for the next ones
+   * asking for as many.
+   */
+  template <class E>
+  std::size_t dispatch(const E &event, const std::vector<InstanceId> &ids,
+                       unsigned threads) {
+    if (threads <= 1)
+      return dispatch(event, ids);
+    if (!m_workers || m_workers->threads() != threads)
+      m_workers = std::make_unique<worker_pool>(threads);
+    std::vector<std::size_t> fired(threads);
+    const std::size_t slice = (ids.size() + threads - 1) / threads;
+    m_workers->run(threads, [&](std::size_t t, unsigned) {
+      const std::size_t begin = std::min(ids.size(), t * slice);
+      const std::size_t end = std::min(ids.size(), begin + slice);
+      fired[t] = dispatch(event, ids.data() + begin, end - begin);
+    });
+    std::size_t total = 0;
+    for (std::size_t f : fired)
+      total += f;
+    return total;
+  }
+
+private:
+  // Empty states take no space: their column stays empty.
+  template <class X> struct Payloads {
+    std::vector<X> values;
+
+    void emplace_back() {
+      if constexpr (!std::is_empty_v<X>)
+        values.emplace_back();
+    }
+
+    X &operator[](InstanceId id) {
+      if constexpr (std::is_empty_v<X>) {
+        static X none;
+        return none;
+      } else {
+        return values[id];
+      }
+    }
+  };
+
+  // Instances bucketed by current state with one counting sort.
+  struct Groups {
+    std::array<std::size_t, Machine::size + 1> begin;
+    std::vector<InstanceId> ids;
+
+    void sort(const std::vector<StateId> &states, const InstanceId *in,
+              std::size_t n) {
+      begin.fill(0);
+      for (std::size_t i = 0; i < n; ++i)
+        ++begin[states[in[i]] + 1];
+      for (std::size_t s = 1; s <= Machine::size; ++s)
+        begin[s] += begin[s - 1];
+      ids.resize(n);
+      std::array<std::size_t, Machine::size> at;
+      std::copy(begin.begin(), begin.end() - 1, at.begin());
+      for (std::size_t i = 0; i < n; ++i)
+        ids[at[states[in[i]]]++] = in[i];
+    }
+
+    struct Range {
+      const InstanceId *first, *last;
+      const InstanceId *begin() const { return first; }
+      const InstanceId *end() const { return last; }
+    };
+
+    Range of(std::size_t s) const {
+      return {ids.data() + begin[s], ids.data() + begin[s + 1]};
+    }
+  };
+
+  template <class Row, class E>
+  bool fire(const Row &row, const E &event, InstanceId id) {
+    Context &context = m_contexts[id];
+    if (row.guard && !row.guard(context, event))
+      return false;
+    const StateId from = m_states[id];
+    if (row.to != from)
+      Machine::exit(from, context);
+    if (row.action)
+      row.action(context, event);
+    if (row.to != from) {
+      m_states[id] = row.to;
+      enter(id, row.to);
+    }
+    return true;
+  }
+
+  void enter(InstanceId id, StateId state) {
+    Machine::visit(state, [&](auto s) {
+      if constexpr (!std::is_empty_v<decltype(s)>)
+        payload<decltype(s)>(id) = {};
+    });
+    Machine::enter(state, m_contexts[id]);
+  }
+
+  std::vector<StateId> m_states;
+  std::vector<Context> m_contexts;
+  std::tuple<Payloads<S>...> m_payloads;
+  std::unique_ptr<worker_pool> m_workers; // for sharded dispatch
+};
+
+#endif /* end of include guard: STATE_MACHINE_POOL_H */
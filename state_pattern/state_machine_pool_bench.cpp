@@ -0,0 +1,120 @@
+#include "state_machine_pool.h"
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+/*
+ * One million connection state machines. Events go to batches of 100000
+ * random devices: one Machine::dispatch per device on separately allocated
+ * devices, against StateMachinePool::dispatch on the whole batch, on one
+ * and on several threads. Build with
+ *
+ *      g++ -std=c++17 -O2 -pthread state_machine_pool_bench.cpp
+ */
+
+struct Disconnected {};
+struct Connecting {
+  std::uint32_t since = 0;
+};
+struct Connected {};
+
+struct Connect {};
+struct Established {};
+struct Interrupt {};
+
+struct Device {
+  std::uint32_t attempts = 0;
+};
+
+static bool mayRetry(Device &d, const Connect &) { return d.attempts < 1000; }
+static void countAttempt(Device &d, const Connect &) { ++d.attempts; }
+static void resetAttempts(Device &d, const Established &) { d.attempts = 0; }
+
+using Machine = StateMachine<
+    Device, States<Disconnected, Connecting, Connected>,
+    Transition<Disconnected, Connect, Connecting, mayRetry, countAttempt>,
+    Transition<Connecting, Established, Connected, nullptr, resetAttempts>,
+    Transition<AnyState, Interrupt, Disconnected>>;
+
+using Pool = StateMachinePool<Machine>;
+
+// What one object per device looks like.
+struct DeviceObject {
+  Device device;
+  Machine::StateId state;
+  Connecting connecting;
+};
+
+template <class F> static double eventsPerSecond(std::size_t events, F &&f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+  return events / d.count();
+}
+
+int main() {
+  const std::size_t devices = 1000000, batch = 100000, rounds = 60;
+
+  std::vector<std::vector<Pool::InstanceId>> batches(rounds);
+  std::uint32_t x = 2463534242u;
+  for (auto &b : batches) {
+    // Distinct ids: a random stride through all devices.
+    const std::uint32_t offset = (x ^= x << 13, x ^= x >> 17, x ^= x << 5);
+    for (std::size_t i = 0; i < batch; ++i)
+      b.push_back((offset + i * 7919) % devices);
+  }
+
+  auto round = [&](std::size_t r, auto &&dispatch) {
+    switch (r % 3) {
+    case 0:
+      return dispatch(Connect{}, batches[r]);
+    case 1:
+      return dispatch(Established{}, batches[r]);
+    default:
+      return dispatch(Interrupt{}, batches[r]);
+    }
+  };
+
+  std::vector<std::unique_ptr<DeviceObject>> objects;
+  for (std::size_t i = 0; i < devices; ++i) {
+    objects.push_back(std::make_unique<DeviceObject>());
+    objects.back()->state = Machine::start(objects.back()->device);
+  }
+  std::size_t objectFired = 0;
+  const double single = eventsPerSecond(rounds * batch, [&] {
+    for (std::size_t r = 0; r < rounds; ++r) {
+      objectFired += round(r, [&](const auto &event, const auto &ids) {
+        std::size_t fired = 0;
+        for (auto id : ids)
+          fired += Machine::dispatch(objects[id]->state,
+                                     objects[id]->device, event);
+        return fired;
+      });
+    }
+  });
+  std::cout << "one object per device: " << single << " events/s ("
+            << objectFired << " fired)\n";
+
+  const unsigned cores = std::max(2u, std::thread::hardware_concurrency());
+  for (unsigned threads : {1u, cores}) {
+    Pool pool;
+    for (std::size_t i = 0; i < devices; ++i)
+      pool.create();
+    std::size_t fired = 0;
+    const double rate = eventsPerSecond(rounds * batch, [&] {
+      for (std::size_t r = 0; r < rounds; ++r) {
+        fired += round(r, [&](const auto &event, const auto &ids) {
+          return pool.dispatch(event, ids, threads);
+        });
+      }
+    });
+    std::cout << "pool, " << threads << " thread(s): " << rate
+              << " events/s (" << fired << " fired, "
+              << pool.count<Connected>() << " connected)\n";
+  }
+  return 0;
+}
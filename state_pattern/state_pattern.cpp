@@ -1,53 +1,100 @@
+#include "state_machine.h"
+#include "timer_wheel.h"
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
-#include <variant>
-
-template <class... Ts> struct overloaded : Ts... { using Ts::operator()...; };
-template <class... Ts> overloaded(Ts...)->overloaded<Ts...>;
 
 struct Connection {
-  struct Disconnected {
-    Disconnected() {
-      std::cout << "Disconnected"
-                << "\n";
-    }
-  };
+  struct Disconnected {};
   struct Connecting {
-    Connecting() {
-      std::cout << "Connecting"
-                << "\n";
-    }
-  };
-  struct Connected {
-    Connected() {
-      std::cout << "Connected"
-                << "\n";
-    }
+    static constexpr TimerWheel::Tick timeout = 5000; // ms
   };
+  struct Connected {};
+
+  struct Connect {};
+  struct Established {};
+  struct Interrupt {};
+
+  static constexpr int maxAttempts = 3;
+
+  static bool mayRetry(Connection &c, const Connect &) {
+    return c.m_attempts < maxAttempts;
+  }
+  static void countAttempt(Connection &c, const Connect &) { ++c.m_attempts; }
+  static void resetAttempts(Connection &c, const Established &) {
+    c.m_attempts = 0;
+  }
 
-  using State = std::variant<Disconnected, Connecting, Connected>;
+  using Machine = StateMachine<
+      Connection, States<Disconnected, Connecting, Connected>,
+      Transition<Disconnected, Connect, Connecting, mayRetry, countAttempt>,
+      Transition<Connecting, Established, Connected, nullptr, resetAttempts>,
+      Transition<Connecting, Timeout, Disconnected>,
+      Transition<AnyState, Interrupt, Disconnected>>;
 
-  Connection() {
-    std::visit(
-        overloaded{
-            [](auto &&) { return Connected(); },
-        },
-        m_connection);
+  void onEnter(Disconnected) { std::cout << "Disconnected\n"; }
+  void onEnter(Connecting) { std::cout << "Connecting\n"; }
+  void onEnter(Connected) { std::cout << "Connected\n"; }
+
+  void armTimeout(TimerWheel::Tick ticks) {
+    m_timeout = m_timers.arm(ticks, reinterpret_cast<std::uintptr_t>(this));
+  }
+  void cancelTimeout() { m_timers.cancel(m_timeout); }
+
+  // For the timer wheel's data.
+  static void expired(std::uint64_t connection) {
+    reinterpret_cast<Connection *>(connection)->timeout();
   }
 
-  void interrupt() {
-    std::visit(
-        overloaded{
-            [](auto &&) { return Disconnected(); },
-        },
-        m_connection);
+  explicit Connection(TimerWheel &timers)
+      : m_timers(timers), m_state(Machine::start(*this)) {
+    connect();
+    established();
   }
 
-  State m_connection = Connecting();
+  Connection(const Connection &) = delete;
+  Connection &operator=(const Connection &) = delete;
+
+  ~Connection() { Machine::exit(m_state, *this); }
+
+  bool connect() { return Machine::dispatch(m_state, *this, Connect{}); }
+  bool established() {
+    return Machine::dispatch(m_state, *this, Established{});
+  }
+  bool interrupt() { return Machine::dispatch(m_state, *this, Interrupt{}); }
+  bool timeout() { return Machine::dispatch(m_state, *this, Timeout{}); }
+
+  TimerWheel &m_timers;
+  TimerWheel::TimerId m_timeout;
+  int m_attempts = 0;
+  Machine::StateId m_state;
 };
 
 int main(int argc, char *argv[]) {
-  Connection con;
+  TimerWheel timers;
+  Connection con(timers);
   con.interrupt();
 
+  // Give up after maxAttempts.
+  for (int i = 0; i <= Connection::maxAttempts; ++i) {
+    if (!con.connect()) {
+      std::cout << "Giving up\n";
+    }
+    con.interrupt();
+  }
+
+  // Connecting for more than 5s ends in Disconnected without polling. A
+  // connection made in time cancels its timer.
+  Connection slow(timers);
+  slow.interrupt();
+  slow.connect();
+  std::size_t expired = timers.advance(4000, Connection::expired);
+  std::cout << "After 4s: " << expired << " timeout(s)\n";
+  slow.established();
+  slow.interrupt();
+  slow.connect();
+  expired = timers.advance(10000, Connection::expired);
+  std::cout << "After 10s: " << expired << " timeout(s)\n";
+
   return 0;
 }
@@ -0,0 +1,168 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/*
+ * A hierarchical timer wheel: four levels of 256 slots, each level a 256
+ * times coarser clock than the one below. A timer goes into the slot of the
+ * finest level that covers its deadline; when a coarser slot comes due, its
+ * timers cascade down. Arming and cancelling are O(1), and expiring costs
+ * O(1) per timer plus at most three cascades.
+ *
+ * Time is counted in ticks of whatever unit the caller chooses and moves
+ * forward only through advance(). A timer carries 64 bits of caller data,
+ * handed back when it expires. Every timer is a 32-byte node in one array,
+ * linked into its slot by index; freed nodes are reused.
+ */
+class TimerWheel {
+public:
+  using Tick = std::uint64_t;
+
+  struct TimerId {
+    std::uint32_t index = 0; // 0 is never a timer
+    std::uint32_t generation = 0;
+  };
+
+  explicit TimerWheel(Tick now = 0) : m_now(now), m_nodes(heads) {
+    for (std::uint32_t i = 0; i < heads; ++i)
+      m_nodes[i].next = m_nodes[i].prev = i;
+  }
+
+  Tick now() const { return m_now; }
+  std::size_t size() const { return m_size; }
+
+  /*
+   * Expire data after delay ticks, at least one.
+   */
+  TimerId arm(Tick delay, std::uint64_t data) {
+    std::uint32_t i = m_free;
+    if (i != none) {
+      m_free = m_nodes[i].next;
+    } else {
+      i = static_cast<std::uint32_t>(m_nodes.size());
+      m_nodes.emplace_back();
+    }
+    Node &n = m_nodes[i];
+    n.deadline = m_now + (delay ? delay : 1);
+    n.data = data;
+    insert(i);
+    ++m_size;
+    return {i, n.generation};
+  }
+
+  /*
+   * Returns false if the timer already expired or was cancelled.
+   */
+  bool cancel(TimerId id) {
+    if (id.index < heads || id.index >= m_nodes.size() ||
+        m_nodes[id.index].generation != id.generation)
+      return false;
+    unlink(id.index);
+    release(id.index);
+    return true;
+  }
+
+  /*
+   * Move the clock to now, calling expired(data) for every timer due on the
+   * way, in order of deadline. Callbacks may arm and cancel timers. Returns
+   * how many expired.
+   */
+  template <class F> std::size_t advance(Tick now, F &&expired) {
+    std::size_t fired = 0;
+    while (m_now < now) {
+      ++m_now;
+      for (unsigned level = levels - 1; level > 0; --level) {
+        if ((m_now & ((Tick(1) << (bits * level)) - 1)) == 0)
+          cascade(level);
+      }
+      const std::uint32_t head = slot(0, m_now);
+      while (m_nodes[head].next != head) {
+        const std::uint32_t i = m_nodes[head].next;
+        unlink(i);
+        if (m_nodes[i].deadline > m_now) {
+          insert(i); // beyond the range of the wheel when armed
+          continue;
+        }
+        const std::uint64_t data = m_nodes[i].data;
+        release(i);
+        ++fired;
+        expired(data);
+      }
+    }
+    return fired;
+  }
+
+private:
+  static constexpr unsigned bits = 8;
+  static constexpr unsigned levels = 4;
+  static constexpr std::uint32_t slots = 1 << bits;
+  static constexpr std::uint32_t heads = levels * slots;
+  static constexpr std::uint32_t none =
+      std::numeric_limits<std::uint32_t>::max();
+
+  // The first heads nodes are the sentinels of the slots' circular lists.
+  struct Node {
+    Tick deadline = 0;
+    std::uint64_t data = 0;
+    std::uint32_t next = none;
+    std::uint32_t prev = none;
+    std::uint32_t generation = 0;
+  };
+  static_assert(sizeof(Node) == 32, "a timer takes 32 bytes");
+
+  static std::uint32_t slot(unsigned level, Tick t) {
+    return level * slots + ((t >> (bits * level)) & (slots - 1));
+  }
+
+  void insert(std::uint32_t i) {
+    const Tick delta = m_nodes[i].deadline - m_now;
+    unsigned level = 0;
+    while (level < levels - 1 && delta >= (Tick(1) << (bits * (level + 1))))
+      ++level;
+    const std::uint32_t head = slot(level, m_nodes[i].deadline);
+    Node &n = m_nodes[i];
+    n.next = head;
+    n.prev = m_nodes[head].prev;
+    m_nodes[n.prev].next = i;
+    m_nodes[head].prev = i;
+  }
+
+  void unlink(std::uint32_t i) {
+    Node &n = m_nodes[i];
+    m_nodes[n.prev].next = n.next;
+    m_nodes[n.next].prev = n.prev;
+  }
+
+  void release(std::uint32_t i) {
+    Node &n = m_nodes[i];
+    ++n.generation;
+    n.next = m_free;
+    n.prev = none;
+    m_free = i;
+    --m_size;
+  }
+
+  // Spread the timers of the slot coming due at this level over the finer
+  // levels.
+  void cascade(unsigned level) {
+    const std::uint32_t head = slot(level, m_now);
+    std::uint32_t i = m_nodes[head].next;
+    m_nodes[head].next = m_nodes[head].prev = head;
+    while (i != head) {
+      const std::uint32_t next = m_nodes[i].next;
+      insert(i);
+      i = next;
+    }
+  }
+
+  Tick m_now;
+  std::vector<Node> m_nodes;
+  std::uint32_t m_free = none;
+  std::size_t m_size = 0;
+};
+
+#endif /* end of include guard: TIMER_WHEEL_H */
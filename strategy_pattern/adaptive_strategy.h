@@ -0,0 +1,187 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef ADAPTIVE_STRATEGY_H
+#define ADAPTIVE_STRATEGY_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Timing of one implementation of a strategy slot.
+ */
+struct strategy_stats {
+  std::string name;
+  std::uint64_t calls = 0;
+  std::uint64_t samples = 0;
+  double mean_ns = 0; // moving average over recent samples
+};
+
+/**
+ * A strategy slot, whatever its signature.
+ */
+class strategy_slot {
+public:
+  virtual ~strategy_slot() = default;
+  virtual const std::string &chosen() const = 0;
+  virtual std::vector<strategy_stats> statistics() const = 0;
+};
+
+template <typename Signature> class adaptive_strategy;
+
+/**
+ * Several interchangeable implementations of one strategy, of which the
+ * fastest one for the current input gets the traffic.
+ *
+ * Picking is an epsilon-greedy bandit: one call in sample_every is timed.
+ * A timed call goes to a random implementation with probability explore,
+ * and to the current best otherwise. The cost of each implementation is
+ * an exponentially weighted moving average of its samples, so when the
+ * input changes, the choice follows. Untimed calls go straight to the
+ * current best.
+ *
+ * Not thread safe; give each thread its own.
+ */
+template <typename R, typename... Args>
+class adaptive_strategy<R(Args...)> : public strategy_slot {
+public:
+  using implementation = std::function<R(Args...)>;
+
+  explicit adaptive_strategy(unsigned sample_every = 16, double explore = 0.1,
+                             double weight = 0.05)
+      : sample_every_(sample_every ? sample_every : 1),
+        explore_(explore * 4294967296.0), weight_(weight) {}
+
+  adaptive_strategy &add(std::string name, implementation impl) {
+    impls_.push_back({std::move(impl), {std::move(name)}});
+    return *this;
+  }
+
+  R operator()(Args... args) {
+    if (impls_.empty())
+      throw std::logic_error("adaptive_strategy: no implementation");
+    if (++calls_ % sample_every_ != 0) {
+      entry &e = impls_[best_];
+      ++e.stats.calls;
+      return e.impl(std::forward<Args>(args)...);
+    }
+    const std::size_t i = pick();
+    entry &e = impls_[i];
+    ++e.stats.calls;
+    const auto start = std::chrono::steady_clock::now();
+    struct timer {
+      adaptive_strategy &self;
+      std::size_t i;
+      std::chrono::steady_clock::time_point start;
+      ~timer() {
+        std::chrono::duration<double, std::nano> d =
+            std::chrono::steady_clock::now() - start;
+        self.sampled(i, d.count());
+      }
+    } t{*this, i, start};
+    return e.impl(std::forward<Args>(args)...);
+  }
+
+  const std::string &chosen() const override {
+    static const std::string none;
+    return impls_.empty() ? none : impls_[best_].stats.name;
+  }
+
+  std::vector<strategy_stats> statistics() const override {
+    std::vector<strategy_stats> r;
+    for (const entry &e : impls_)
+      r.push_back(e.stats);
+    return r;
+  }
+
+private:
+  struct entry {
+    implementation impl;
+    strategy_stats stats;
+  };
+
+  std::size_t pick() {
+    // Every implementation is tried before any is trusted.
+    for (std::size_t i = 0; i < impls_.size(); ++i) {
+      if (impls_[i].stats.samples == 0)
+        return i;
+    }
+    if (random() < explore_)
+      return random() % impls_.size();
+    return best_;
+  }
+
+  void sampled(std::size_t i, double ns) {
+    strategy_stats &s = impls_[i].stats;
+    s.mean_ns = s.samples++ ? s.mean_ns + weight_ * (ns - s.mean_ns) : ns;
+    for (std::size_t j = 0; j < impls_.size(); ++j) {
+      const strategy_stats &c = impls_[j].stats;
+      if (c.samples > 0 && c.mean_ns < impls_[best_].stats.mean_ns)
+        best_ = j;
+    }
+  }
+
+  std::uint32_t random() {
+    // xorshift32: cheap, and good enough to spread exploration.
+    rng_ ^= rng_ << 13;
+    rng_ ^= rng_ >> 17;
+    rng_ ^= rng_ << 5;
+    return rng_;
+  }
+
+  std::vector<entry> impls_;
+  std::size_t best_ = 0;
+  std::uint64_t calls_ = 0;
+  const unsigned sample_every_;
+  const double explore_; // scaled to the range of random()
+  const double weight_;
+  std::uint32_t rng_ = 2463534242u;
+};
+
+/**
+ * Strategy slots by name.
+ */
+class strategy_registry {
+public:
+  /**
+   * The slot with this name, created on first use. Throws if it exists
+   * with another signature.
+   */
+  template <typename Signature>
+  adaptive_strategy<Signature> &slot(const std::string &name) {
+    std::unique_ptr<strategy_slot> &s = slots_[name];
+    if (!s)
+      s = std::make_unique<adaptive_strategy<Signature>>();
+    auto *typed = dynamic_cast<adaptive_strategy<Signature> *>(s.get());
+    if (!typed)
+      throw std::invalid_argument("strategy_registry: wrong signature for " +
+                                  name);
+    return *typed;
+  }
+
+  /**
+   * The chosen implementation and timings of every slot.
+   */
+  void report(std::ostream &out) const {
+    for (const auto &[name, s] : slots_) {
+      out << name << ": using " << s->chosen() << "\n";
+      for (const strategy_stats &st : s->statistics()) {
+        out << "  " << st.name << ": " << st.calls << " calls, "
+            << st.samples << " samples, " << st.mean_ns << " ns\n";
+      }
+    }
+  }
+
+private:
+  std::map<std::string, std::unique_ptr<strategy_slot>> slots_;
+};
+
+#endif /* end of include guard: ADAPTIVE_STRATEGY_H */
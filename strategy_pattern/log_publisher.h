@@ -0,0 +1,340 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef LOG_PUBLISHER_H
+#define LOG_PUBLISHER_H
+
+#include "strategy.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <initializer_list>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * A format strategy that rewrites the text to publish in place, so several
+ * of them run back to back over the same bytes while they are in cache.
+ */
+template <typename Transform>
+concept InPlaceTextTransform =
+    requires(Transform &transform, char *first, char *last) {
+      { transform(first, last) } -> std::same_as<void>;
+    };
+
+/**
+ * Call f with every complete line of text, without its '\n'. Returns the
+ * length of the prefix of text that was consumed; the rest is an
+ * unterminated line.
+ *
+ * With SSE2, newlines are found 16 bytes at a time.
+ */
+template <typename F>
+std::size_t for_each_line(std::string_view text, F &&f) {
+  const char *begin = text.data();
+  const char *p = begin;
+  const char *const end = begin + text.size();
+#ifdef __SSE2__
+  const __m128i newline = _mm_set1_epi8('\n');
+  for (; end - p >= 16; p += 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, newline));
+    for (; mask != 0; mask &= mask - 1) {
+      const char *eol = p + __builtin_ctz(mask);
+      f(std::string_view(begin, eol - begin));
+      begin = eol + 1;
+    }
+  }
+#endif
+  for (; p != end; ++p) {
+    if (*p == '\n') {
+      f(std::string_view(begin, p - begin));
+      begin = p + 1;
+    }
+  }
+  return begin - text.data();
+}
+
+namespace detail {
+
+// Flip bit 5 of every byte in [from, to], 16 bytes at a time with SSE2.
+template <char from, char to>
+inline void flip_case_ascii(char *first, char *last) {
+#ifdef __SSE2__
+  // Bytes >= 0x80 are negative as signed chars and never in range.
+  const __m128i low = _mm_set1_epi8(from - 1);
+  const __m128i high = _mm_set1_epi8(to + 1);
+  const __m128i bit = _mm_set1_epi8(0x20);
+  for (; last - first >= 16; first += 16) {
+    __m128i *p = reinterpret_cast<__m128i *>(first);
+    const __m128i v = _mm_loadu_si128(p);
+    const __m128i in_range =
+        _mm_and_si128(_mm_cmpgt_epi8(v, low), _mm_cmplt_epi8(v, high));
+    _mm_storeu_si128(p, _mm_xor_si128(v, _mm_and_si128(in_range, bit)));
+  }
+#endif
+  for (; first != last; ++first) {
+    if (*first >= from && *first <= to)
+      *first ^= 0x20;
+  }
+}
+
+} // namespace detail
+
+/**
+ * Built-in format strategies: ASCII case folding. Other bytes, including
+ * UTF-8 sequences, are left alone.
+ */
+struct upper_case {
+  void operator()(char *first, char *last) const {
+    detail::flip_case_ascii<'a', 'z'>(first, last);
+  }
+};
+
+struct lower_case {
+  void operator()(char *first, char *last) const {
+    detail::flip_case_ascii<'A', 'Z'>(first, last);
+  }
+};
+
+/**
+ * Built-in filter strategy: lines with a length in [min, max].
+ */
+struct length_between {
+  std::size_t min = 0;
+  std::size_t max = std::string_view::npos;
+
+  bool operator()(std::string_view line) const {
+    return line.size() >= min && line.size() <= max;
+  }
+};
+
+/**
+ * Built-in filter strategy: lines starting with one of a few prefixes, such
+ * as log levels.
+ *
+ * Prefixes of up to 8 bytes are matched with a single 64-bit load of the
+ * line and one masked compare per prefix; longer ones fall back to memcmp.
+ */
+class starts_with_any {
+public:
+  starts_with_any(std::initializer_list<std::string_view> prefixes) {
+    for (std::string_view prefix : prefixes) {
+      if (prefix.size() > 8) {
+        long_.emplace_back(prefix);
+        continue;
+      }
+      word w{0, 0, prefix.size()};
+      std::memcpy(&w.bits, prefix.data(), prefix.size());
+      std::memset(&w.mask, 0xff, prefix.size());
+      short_.push_back(w);
+    }
+  }
+
+  bool operator()(std::string_view line) const {
+    std::uint64_t head = 0;
+    std::memcpy(&head, line.data(), std::min<std::size_t>(line.size(), 8));
+    for (const word &w : short_) {
+      if ((head & w.mask) == w.bits && line.size() >= w.size)
+        return true;
+    }
+    for (const std::string &prefix : long_) {
+      if (line.starts_with(prefix))
+        return true;
+    }
+    return false;
+  }
+
+private:
+  struct word {
+    std::uint64_t bits;
+    std::uint64_t mask;
+    std::size_t size;
+  };
+
+  std::vector<word> short_;
+  std::vector<std::string> long_;
+};
+
+/**
+ * Filters composed into one: a line passes if all of them (or any of them)
+ * accept it. Filters are tried in order and stop early.
+ */
+template <TextFilter<std::string_view>... Filters> struct match_all {
+  std::tuple<Filters...> filters;
+
+  match_all(Filters... fs) : filters(std::move(fs)...) {}
+
+  bool operator()(std::string_view line) const {
+    return std::apply([&](const auto &... f) { return (f(line) && ...); },
+                      filters);
+  }
+};
+
+template <TextFilter<std::string_view>... Filters> struct match_any {
+  std::tuple<Filters...> filters;
+
+  match_any(Filters... fs) : filters(std::move(fs)...) {}
+
+  bool operator()(std::string_view line) const {
+    return std::apply([&](const auto &... f) { return (f(line) || ...); },
+                      filters);
+  }
+};
+
+/**
+ * A read-only mapping of a whole file, to publish without copying it in.
+ */
+class mapped_text {
+public:
+  explicit mapped_text(const std::string &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error("mapped_text: cannot open " + path);
+    struct stat st;
+    ::fstat(fd, &st);
+    size_ = st.st_size;
+    if (size_ > 0) {
+      void *p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error("mapped_text: cannot map " + path);
+      }
+      ::madvise(p, size_, MADV_SEQUENTIAL);
+      data_ = static_cast<const char *>(p);
+    }
+    ::close(fd);
+  }
+
+  mapped_text(const mapped_text &) = delete;
+  mapped_text &operator=(const mapped_text &) = delete;
+
+  ~mapped_text() {
+    if (data_)
+      ::munmap(const_cast<char *>(data_), size_);
+  }
+
+  std::string_view view() const { return {data_, size_}; }
+
+private:
+  const char *data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+/**
+ * Publishes a stream of text line by line: every line the filter accepts is
+ * copied to an output buffer, rewritten in place by each transform, and
+ * written out in large blocks. Filter and transforms are fixed at compile
+ * time, so one pass over the input runs all of them.
+ *
+ * Input arrives in chunks of any size--a mapped file, or blocks read from a
+ * stream. A line split across chunks is carried over.
+ */
+template <TextFilter<std::string_view> Filter,
+          InPlaceTextTransform... Transforms>
+class log_publisher {
+public:
+  explicit log_publisher(std::ostream &out, Filter filter = {},
+                         Transforms... transforms)
+      : out_(out), filter_(std::move(filter)),
+        transforms_(std::move(transforms)...) {
+    buffer_.reserve(flush_size + 4096);
+  }
+
+  log_publisher(const log_publisher &) = delete;
+  log_publisher &operator=(const log_publisher &) = delete;
+
+  ~log_publisher() { finish(); }
+
+  void publish(std::string_view chunk) {
+    bytes_in_ += chunk.size();
+    if (!partial_.empty()) {
+      const std::size_t eol = chunk.find('\n');
+      if (eol == std::string_view::npos) {
+        partial_.append(chunk);
+        return;
+      }
+      partial_.append(chunk.substr(0, eol));
+      line(partial_);
+      partial_.clear();
+      chunk.remove_prefix(eol + 1);
+    }
+    const std::size_t done =
+        for_each_line(chunk, [this](std::string_view l) { line(l); });
+    partial_.assign(chunk.substr(done));
+    flush();
+  }
+
+  /**
+   * Publish a whole stream, reading it in blocks of chunk_size bytes.
+   */
+  void publish(std::istream &in, std::size_t chunk_size = 1 << 20) {
+    std::vector<char> chunk(chunk_size);
+    while (in.read(chunk.data(), chunk.size()) || in.gcount() > 0)
+      publish(std::string_view(chunk.data(), in.gcount()));
+  }
+
+  /**
+   * Publish a last line without '\n', and flush.
+   */
+  void finish() {
+    if (!partial_.empty()) {
+      line(partial_);
+      partial_.clear();
+    }
+    flush();
+  }
+
+  std::size_t bytes_in() const { return bytes_in_; }
+  std::size_t lines_in() const { return lines_in_; }
+  std::size_t lines_out() const { return lines_out_; }
+
+private:
+  static constexpr std::size_t flush_size = 1 << 20;
+
+  void line(std::string_view l) {
+    ++lines_in_;
+    if (!filter_(l))
+      return;
+    ++lines_out_;
+    const std::size_t at = buffer_.size();
+    buffer_.append(l);
+    char *first = buffer_.data() + at;
+    char *last = buffer_.data() + buffer_.size();
+    std::apply([&](auto &... t) { (t(first, last), ...); }, transforms_);
+    buffer_.push_back('\n');
+    if (buffer_.size() >= flush_size)
+      flush();
+  }
+
+  void flush() {
+    if (!buffer_.empty()) {
+      out_.write(buffer_.data(), buffer_.size());
+      buffer_.clear();
+    }
+  }
+
+  std::ostream &out_;
+  Filter filter_;
+  std::tuple<Transforms...> transforms_;
+  std::string buffer_;
+  std::string partial_;
+  std::size_t bytes_in_ = 0;
+  std::size_t lines_in_ = 0;
+  std::size_t lines_out_ = 0;
+};
+
+#endif /* end of include guard: LOG_PUBLISHER_H */
@@ -0,0 +1,116 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "log_publisher.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <string_view>
+
+/**
+ * Throughput of log_publisher against publishing line by line with
+ * publish_text2-style strategies: keep errors and warnings of at most 60
+ * bytes, upper-cased. Build with
+ *
+ *      g++ -std=c++20 -O2 log_publisher_bench.cpp
+ *
+ * and pass a log file to map it, or nothing for 256 MiB of generated log.
+ * Output goes to a stream buffer that counts and drops characters.
+ */
+class counting_buffer : public std::streambuf {
+public:
+  std::size_t count = 0;
+
+protected:
+  int_type overflow(int_type c) override {
+    ++count;
+    return c;
+  }
+
+  std::streamsize xsputn(const char *, std::streamsize n) override {
+    count += n;
+    return n;
+  }
+};
+
+static std::string generated_log(std::size_t bytes) {
+  static const char *const levels[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+  std::string log;
+  log.reserve(bytes + 128);
+  for (std::size_t i = 0; log.size() < bytes; ++i) {
+    log += levels[i % 4];
+    log += " - request ";
+    log += std::to_string(i);
+    log += i % 3 ? " took " : " was retried after ";
+    log += std::to_string(i * 7 % 1000);
+    log += " ms\n";
+  }
+  return log;
+}
+
+template <class F>
+static void report(const char *name, std::string_view log, F &&publish) {
+  counting_buffer sink;
+  std::ostream out(&sink);
+  auto start = std::chrono::steady_clock::now();
+  publish(out);
+  std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+  std::cout << name << ": " << log.size() / d.count() / 1e9 << " GB/s ("
+            << sink.count << " bytes out)\n";
+}
+
+int main(int argc, char *argv[]) {
+  std::string generated;
+  std::unique_ptr<mapped_text> mapped;
+  std::string_view log;
+  if (argc > 1) {
+    mapped = std::make_unique<mapped_text>(argv[1]);
+    log = mapped->view();
+  } else {
+    generated = generated_log(256 << 20);
+    log = generated;
+  }
+
+  report("line by line", log, [&](std::ostream &out) {
+    auto filter = [](std::string text) {
+      return (text.starts_with("ERROR") || text.starts_with("WARNING")) &&
+             text.size() <= 60;
+    };
+    auto format = [](std::string text) {
+      std::transform(text.begin(), text.end(), text.begin(), ::toupper);
+      return text;
+    };
+    std::size_t begin = 0;
+    for (std::size_t eol; (eol = log.find('\n', begin)) != log.npos;
+         begin = eol + 1) {
+      std::string line(log.substr(begin, eol - begin));
+      if (filter(line))
+        out << format(line) << "\n";
+    }
+  });
+
+  report("log_publisher", log, [&](std::ostream &out) {
+    log_publisher publisher(out,
+                            match_all{starts_with_any{"ERROR", "WARNING"},
+                                      length_between{0, 60}},
+                            upper_case{});
+    publisher.publish(log);
+    publisher.finish();
+  });
+
+  report("log_publisher, 64 KiB chunks", log, [&](std::ostream &out) {
+    log_publisher publisher(out,
+                            match_all{starts_with_any{"ERROR", "WARNING"},
+                                      length_between{0, 60}},
+                            upper_case{});
+    for (std::size_t at = 0; at < log.size(); at += 64 << 10)
+      publisher.publish(log.substr(at, 64 << 10));
+    publisher.finish();
+  });
+  return 0;
+}
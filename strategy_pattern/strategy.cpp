@@ -2,29 +2,15 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+#include "log_publisher.h"
+#include "strategy.h"
 #include <algorithm>
 #include <cctype>
-#include <functional>
 #include <iostream>
+#include <iterator>
+#include <sstream>
 #include <string>
-
-static void publish_text(std::string text,
-                         std::function<bool(std::string)> filter,
-                         std::function<std::string(std::string)> format) {
-  if (filter(text)) {
-    std::cout << format(text) << "\n";
-  }
-}
-
-// TODO: use concepts to define correct return types for UnaryPredicate and
-// UnaryOperator
-template <typename UnaryPredicate, typename UnaryOperator>
-static void publish_text2(std::string text, UnaryPredicate &&filter,
-                          UnaryOperator &&format) {
-  if (filter(text)) {
-    std::cout << format(text) << "\n";
-  }
-}
+#include <string_view>
 
 int main() {
   publish_text2(
@@ -46,4 +32,24 @@ int main() {
                                 ::tolower);
                  return text;
                });
+  std::string buffer;
+  publish_text3(
+      "WARNING - running low", [](std::string_view text) { return true; },
+      [](std::string_view text, std::string &out) {
+        std::transform(text.begin(), text.end(), std::back_inserter(out),
+                       ::tolower);
+      },
+      buffer);
+
+  // The same kind of strategies, streamed over a whole log in one pass.
+  std::istringstream log("DEBUG - connecting\n"
+                         "ERROR - connection refused\n"
+                         "INFO - retrying in a very long while\n"
+                         "WARNING - disk almost full\n");
+  log_publisher publisher(
+      std::cout,
+      match_all{starts_with_any{"ERROR", "WARNING"}, length_between{0, 30}},
+      upper_case{});
+  publisher.publish(log, 16);
+  publisher.finish();
 }
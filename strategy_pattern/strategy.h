@@ -0,0 +1,80 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef STRATEGY_H
+#define STRATEGY_H
+
+#include <concepts>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/**
+ * A filter strategy decides whether a text gets published.
+ */
+template <typename Filter, typename Text>
+concept TextFilter = std::predicate<Filter &, Text>;
+
+/**
+ * A format strategy returns the text to publish.
+ */
+template <typename Format, typename Text>
+concept TextFormat =
+    std::invocable<Format &, Text> &&
+    std::convertible_to<std::invoke_result_t<Format &, Text>, std::string>;
+
+/**
+ * A format strategy that appends the text to publish to a buffer instead of
+ * returning a new string.
+ */
+template <typename Format>
+concept BufferedTextFormat =
+    requires(Format &format, std::string_view text, std::string &out) {
+      { format(text, out) } -> std::same_as<void>;
+    };
+
+/**
+ * Strategies chosen at run time: every call goes through two type-erased
+ * calls and copies text into each of them.
+ */
+inline void publish_text(std::string text,
+                         std::function<bool(std::string)> filter,
+                         std::function<std::string(std::string)> format) {
+  if (filter(text)) {
+    std::cout << format(text) << "\n";
+  }
+}
+
+/**
+ * Strategies chosen at compile time, but text is still copied.
+ */
+template <TextFilter<std::string> UnaryPredicate,
+          TextFormat<std::string> UnaryOperator>
+void publish_text2(std::string text, UnaryPredicate &&filter,
+                   UnaryOperator &&format) {
+  if (filter(text)) {
+    std::cout << format(text) << "\n";
+  }
+}
+
+/**
+ * Strategies chosen at compile time, text passed as a view, and the format
+ * strategy writing into a caller-provided buffer. Reusing the buffer across
+ * calls makes publishing allocation free once it has grown.
+ */
+template <TextFilter<std::string_view> UnaryPredicate,
+          BufferedTextFormat Formatter>
+void publish_text3(std::string_view text, UnaryPredicate &&filter,
+                   Formatter &&format, std::string &buffer) {
+  if (filter(text)) {
+    buffer.clear();
+    format(text, buffer);
+    buffer.push_back('\n');
+    std::cout.write(buffer.data(), buffer.size());
+  }
+}
+
+#endif /* end of include guard: STRATEGY_H */
@@ -0,0 +1,105 @@
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "strategy.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * publish_text, publish_text2 and publish_text3 on a million-message log
+ * stream: publish errors and short messages, upper-cased. Build with
+ *
+ *      g++ -std=c++20 -O2 strategy_bench.cpp
+ *
+ * Output goes to a stream buffer that counts and drops characters, so the
+ * time is spent in the strategies and not in the terminal.
+ */
+class counting_buffer : public std::streambuf {
+public:
+  std::size_t count = 0;
+
+protected:
+  int_type overflow(int_type c) override {
+    ++count;
+    return c;
+  }
+
+  std::streamsize xsputn(const char *, std::streamsize n) override {
+    count += n;
+    return n;
+  }
+};
+
+static std::vector<std::string> log_stream(std::size_t n) {
+  static const char *const levels[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+  std::vector<std::string> messages;
+  messages.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    messages.push_back(std::string(levels[i % 4]) + " - request " +
+                       std::to_string(i) + " took " +
+                       std::to_string(i * 7 % 1000) + " ms");
+  }
+  return messages;
+}
+
+template <class F>
+static double ns_per_message(const char *name,
+                             const std::vector<std::string> &messages,
+                             F &&publish) {
+  counting_buffer out;
+  std::streambuf *previous = std::cout.rdbuf(&out);
+  auto start = std::chrono::steady_clock::now();
+  for (const std::string &message : messages)
+    publish(message);
+  std::chrono::duration<double, std::nano> d =
+      std::chrono::steady_clock::now() - start;
+  std::cout.rdbuf(previous);
+  const double ns = d.count() / messages.size();
+  std::cout << name << ": " << ns << " ns/message (" << out.count
+            << " bytes)\n";
+  return ns;
+}
+
+int main() {
+  const std::vector<std::string> messages = log_stream(1000000);
+
+  auto filter = [](std::string text) {
+    return text.starts_with("ERROR") || text.length() < 30;
+  };
+  auto format = [](std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), ::toupper);
+    return text;
+  };
+  auto view_filter = [](std::string_view text) {
+    return text.starts_with("ERROR") || text.length() < 30;
+  };
+  auto buffered_format = [](std::string_view text, std::string &out) {
+    for (unsigned char c : text)
+      out.push_back(static_cast<char>(::toupper(c)));
+  };
+
+  const double erased =
+      ns_per_message("publish_text", messages, [&](const std::string &m) {
+        publish_text(m, filter, format);
+      });
+  const double templated =
+      ns_per_message("publish_text2", messages, [&](const std::string &m) {
+        publish_text2(m, filter, format);
+      });
+  std::string buffer;
+  const double buffered =
+      ns_per_message("publish_text3", messages, [&](const std::string &m) {
+        publish_text3(m, view_filter, buffered_format, buffer);
+      });
+  std::cout << "publish_text3 is " << erased / buffered
+            << "x as fast as publish_text, " << templated / buffered
+            << "x as fast as publish_text2\n";
+  return 0;
+}